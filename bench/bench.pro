@@ -0,0 +1,6 @@
+# benchmarks for the render and layout pipeline
+# build with: qmake bench/bench.pro && make
+# harness: katarakt-bench, drives the viewer headlessly
+# corpus:  katarakt-corpus, generates test documents, see corpus/make-corpus.sh
+TEMPLATE = subdirs
+SUBDIRS = harness corpus
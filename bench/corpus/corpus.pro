@@ -0,0 +1,12 @@
+TEMPLATE = app
+TARGET = katarakt-corpus
+DEPENDPATH += .
+INCLUDEPATH += .
+CONFIG += console
+CONFIG -= app_bundle
+QT = core
+
+DEFINES += QT_NO_CAST_FROM_ASCII QT_NO_CAST_TO_ASCII
+
+HEADERS +=  pdfwriter.h generator.h
+SOURCES +=  main.cpp pdfwriter.cpp generator.cpp
@@ -0,0 +1,300 @@
+#include <QStringList>
+#include "generator.h"
+
+using namespace std;
+
+
+// number of different images, pages pick one of them
+static const int image_variants = 4;
+static const float margin = 50;
+static const float gutter = 20;
+static const float font_size = 10;
+static const float leading = 12;
+
+static const char *words[] = {
+	"lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+	"sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore",
+	"magna", "aliqua", "enim", "ad", "minim", "veniam", "quis", "nostrud",
+	"exercitation", "ullamco", "laboris", "nisi", "aliquip", "ex", "ea", "commodo",
+	"consequat", "duis", "aute", "irure", "in", "reprehenderit", "voluptate",
+	"velit", "esse", "cillum", "fugiat", "nulla", "pariatur", "excepteur", "sint",
+	"occaecat", "cupidatat", "non", "proident", "sunt", "culpa", "qui", "officia",
+	"deserunt", "mollit", "anim", "id", "est", "laborum", "katarakt"
+};
+static const int word_count = sizeof(words) / sizeof(words[0]);
+
+static QByteArray num(float x) {
+	return QByteArray::number(x, 'f', 1);
+}
+
+
+CorpusOptions::CorpusOptions() :
+		pages(100),
+		text_lines(50),
+		text_columns(1),
+		paths(20),
+		images(1),
+		image_size(256),
+		links(2),
+		toc_depth(2),
+		mixed_sizes(false),
+		named_dests(false),
+		seed(1) {
+}
+
+
+CorpusGenerator::CorpusGenerator(const CorpusOptions &options) :
+		options(options),
+		state(options.seed != 0 ? options.seed : 1) {
+}
+
+unsigned int CorpusGenerator::next() {
+	// xorshift32
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+int CorpusGenerator::random(int min, int max) {
+	return min + next() % (max - min + 1);
+}
+
+bool CorpusGenerator::generate(const QString &file) {
+	int catalog_id = pdf.reserve();
+	int pages_id = pdf.reserve();
+	int font_id = pdf.add_object("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>");
+
+	for (int i = 0; i < image_variants && options.images > 0; i++) {
+		QByteArray dict = "/Type /XObject /Subtype /Image /Width " + QByteArray::number(options.image_size) +
+			" /Height " + QByteArray::number(options.image_size) +
+			" /ColorSpace /DeviceRGB /BitsPerComponent 8";
+		image_ids.push_back(pdf.add_stream(dict, image_data(options.image_size)));
+	}
+
+	// pages are referenced by links and the outline, reserve them first
+	for (int page = 0; page < options.pages; page++) {
+		page_ids.push_back(pdf.reserve());
+		page_sizes.push_back(random_page_size());
+	}
+
+	QByteArray kids;
+	for (int page = 0; page < options.pages; page++) {
+		QSizeF size = page_sizes[page];
+		QByteArray content = vector_content(size);
+		content += image_content(size);
+		content += text_content(size, page);
+		int content_id = pdf.add_stream(QByteArray(), content);
+
+		QByteArray resources = "<< /Font << /F1 " + PdfWriter::ref(font_id) + " >>";
+		if (!image_ids.isEmpty()) {
+			resources += " /XObject <<";
+			for (int i = 0; i < image_ids.size(); i++) {
+				resources += " /Im" + QByteArray::number(i) + " " + PdfWriter::ref(image_ids[i]);
+			}
+			resources += " >>";
+		}
+		resources += " >>";
+
+		QByteArray body = "<< /Type /Page /Parent " + PdfWriter::ref(pages_id) +
+			" /MediaBox [0 0 " + num(size.width()) + " " + num(size.height()) + "]" +
+			" /Resources " + resources +
+			" /Contents " + PdfWriter::ref(content_id);
+		if (options.links > 0 && options.pages > 1) {
+			body += " /Annots " + link_annotations(size);
+		}
+		body += " >>";
+		pdf.set_object(page_ids[page], body);
+		kids += PdfWriter::ref(page_ids[page]) + " ";
+	}
+	pdf.set_object(pages_id, "<< /Type /Pages /Kids [" + kids + "] /Count " +
+			QByteArray::number(options.pages) + " >>");
+
+	QByteArray catalog = "<< /Type /Catalog /Pages " + PdfWriter::ref(pages_id);
+	if (options.toc_depth > 0 && options.pages > 0) {
+		int outlines_id = pdf.reserve();
+		QList<int> top = add_outline(outlines_id, 0, options.pages, options.toc_depth, QString());
+		pdf.set_object(outlines_id, "<< /Type /Outlines /First " + PdfWriter::ref(top.first()) +
+				" /Last " + PdfWriter::ref(top.last()) +
+				" /Count " + QByteArray::number(top.size()) + " >>");
+		catalog += " /Outlines " + PdfWriter::ref(outlines_id);
+	}
+	if (options.named_dests) {
+		QByteArray dests = "<<";
+		for (int page = 0; page < options.pages; page++) {
+			dests += " /page." + QByteArray::number(page + 1) + " " +
+				explicit_destination(page, page_sizes[page].height());
+		}
+		dests += " >>";
+		catalog += " /Dests " + PdfWriter::ref(pdf.add_object(dests));
+	}
+	catalog += " >>";
+	pdf.set_object(catalog_id, catalog);
+
+	return pdf.save(file, catalog_id);
+}
+
+QSizeF CorpusGenerator::random_page_size() {
+	if (!options.mixed_sizes) {
+		return QSizeF(595, 842); // A4
+	}
+	switch (random(0, 5)) {
+		case 0: return QSizeF(612, 792); // letter
+		case 1: return QSizeF(842, 595); // A4 landscape
+		case 2: return QSizeF(420, 595); // A5
+		case 3: return QSizeF(1191, 842); // A3 landscape
+		default: return QSizeF(595, 842);
+	}
+}
+
+QByteArray CorpusGenerator::text_content(const QSizeF &size, int page) {
+	if (options.text_lines <= 0) {
+		return QByteArray();
+	}
+	int columns = qMax(1, options.text_columns);
+	float column_width = (size.width() - 2 * margin - (columns - 1) * gutter) / columns;
+	int max_lines = (size.height() - 2 * margin) / leading;
+	int lines_per_column = qMin((options.text_lines + columns - 1) / columns, max_lines);
+	// average glyph width of Helvetica is about half the font size
+	int max_chars = column_width / (font_size * 0.5f);
+
+	QByteArray out = "0 g\n";
+	int remaining = options.text_lines;
+	for (int column = 0; column < columns && remaining > 0; column++) {
+		float x = margin + column * (column_width + gutter);
+		out += "BT /F1 " + num(font_size) + " Tf " + num(leading) + " TL " +
+			num(x) + " " + num(size.height() - margin - font_size) + " Td\n";
+		for (int line = 0; line < lines_per_column && remaining > 0; line++, remaining--) {
+			QStringList text;
+			int length = 0;
+			if (line == 0 && column == 0) {
+				// something unique per page to search for
+				text << QString::fromUtf8("page%1").arg(page + 1);
+				length = text.back().length();
+			}
+			while (true) {
+				QString word = QString::fromUtf8(words[random(0, word_count - 1)]);
+				if (length + word.length() + 1 > max_chars) {
+					break;
+				}
+				text << word;
+				length += word.length() + 1;
+			}
+			out += PdfWriter::string(text.join(QString::fromUtf8(" "))) + " Tj T*\n";
+		}
+		out += "ET\n";
+	}
+	return out;
+}
+
+QByteArray CorpusGenerator::vector_content(const QSizeF &size) {
+	QByteArray out;
+	float w = size.width(), h = size.height();
+	for (int i = 0; i < options.paths; i++) {
+		QByteArray color = num(random(0, 100) / 100.0f) + " " +
+			num(random(0, 100) / 100.0f) + " " + num(random(0, 100) / 100.0f);
+		bool fill = i % 3 == 0;
+		out += color + (fill ? " rg\n" : " RG\n");
+		out += num(random(1, 30) / 10.0f) + " w\n";
+		out += num(random(0, w)) + " " + num(random(0, h)) + " m\n";
+		int segments = random(2, 6);
+		for (int s = 0; s < segments; s++) {
+			out += num(random(0, w)) + " " + num(random(0, h)) + " " +
+				num(random(0, w)) + " " + num(random(0, h)) + " " +
+				num(random(0, w)) + " " + num(random(0, h)) + " c\n";
+		}
+		out += fill ? "f\n" : "S\n";
+	}
+	return out;
+}
+
+QByteArray CorpusGenerator::image_content(const QSizeF &size) {
+	QByteArray out;
+	if (image_ids.isEmpty()) {
+		return out;
+	}
+	for (int i = 0; i < options.images; i++) {
+		float side = random(50, qMin(size.width(), size.height()) / 2);
+		float x = random(0, size.width() - side);
+		float y = random(0, size.height() - side);
+		out += "q " + num(side) + " 0 0 " + num(side) + " " + num(x) + " " + num(y) + " cm /Im" +
+			QByteArray::number(random(0, image_ids.size() - 1)) + " Do Q\n";
+	}
+	return out;
+}
+
+QByteArray CorpusGenerator::link_annotations(const QSizeF &size) {
+	QByteArray out = "[";
+	for (int i = 0; i < options.links; i++) {
+		float x = random(margin, size.width() - margin - 100);
+		float y = random(margin, size.height() - margin - leading);
+		out += " << /Type /Annot /Subtype /Link /Border [0 0 0] /Rect [" +
+			num(x) + " " + num(y) + " " + num(x + 100) + " " + num(y + leading) + "]" +
+			" /Dest " + destination(random(0, options.pages - 1)) + " >>";
+	}
+	out += " ]";
+	return out;
+}
+
+QByteArray CorpusGenerator::image_data(int size) {
+	QByteArray data;
+	data.reserve(size * size * 3);
+	int variant = next() % 256;
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			// gradient with noise, so it neither compresses to nothing nor looks flat
+			data += (char) (x * 255 / size);
+			data += (char) (y * 255 / size);
+			data += (char) (((x ^ y) + variant + (next() & 31)) & 255);
+		}
+	}
+	return data;
+}
+
+QList<int> CorpusGenerator::add_outline(int parent, int first, int last, int depth, const QString &prefix) {
+	QList<int> ids;
+	int parts = qMin(4, last - first);
+	if (depth <= 0 || parts <= 0) {
+		return ids;
+	}
+	for (int i = 0; i < parts; i++) {
+		ids.push_back(pdf.reserve());
+	}
+	for (int i = 0; i < parts; i++) {
+		int a = first + (last - first) * i / parts;
+		int b = first + (last - first) * (i + 1) / parts;
+		QString number = prefix + QString::number(i + 1);
+		QList<int> children = add_outline(ids[i], a, b, depth - 1, number + QString::fromUtf8("."));
+
+		QByteArray body = "<< /Title " + PdfWriter::string(QString::fromUtf8("Section %1").arg(number)) +
+			" /Parent " + PdfWriter::ref(parent) +
+			" /Dest " + destination(a);
+		if (i > 0) {
+			body += " /Prev " + PdfWriter::ref(ids[i - 1]);
+		}
+		if (i < parts - 1) {
+			body += " /Next " + PdfWriter::ref(ids[i + 1]);
+		}
+		if (!children.isEmpty()) {
+			// negative: closed, shows the number of direct children
+			body += " /First " + PdfWriter::ref(children.first()) +
+				" /Last " + PdfWriter::ref(children.last()) +
+				" /Count -" + QByteArray::number(children.size());
+		}
+		body += " >>";
+		pdf.set_object(ids[i], body);
+	}
+	return ids;
+}
+
+QByteArray CorpusGenerator::destination(int page) const {
+	if (options.named_dests) {
+		return "/page." + QByteArray::number(page + 1);
+	}
+	return explicit_destination(page, page_sizes[page].height());
+}
+
+QByteArray CorpusGenerator::explicit_destination(int page, float y) const {
+	return "[" + PdfWriter::ref(page_ids[page]) + " /XYZ 0 " + num(y) + " null]";
+}
+
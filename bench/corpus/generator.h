@@ -0,0 +1,62 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <QByteArray>
+#include <QList>
+#include <QSizeF>
+#include <QString>
+#include "pdfwriter.h"
+
+
+struct CorpusOptions {
+	CorpusOptions();
+
+	int pages;
+	int text_lines;  // lines of text per page
+	int text_columns;
+	int paths;       // vector paths per page
+	int images;      // raster images per page
+	int image_size;  // image width and height in pixels
+	int links;       // link annotations per page
+	int toc_depth;   // 0 for no outline
+	bool mixed_sizes;
+	bool named_dests; // outline uses named destinations
+	unsigned int seed;
+};
+
+
+// generates reproducible documents, the same options give the same file
+class CorpusGenerator {
+public:
+	CorpusGenerator(const CorpusOptions &options);
+
+	bool generate(const QString &file);
+
+private:
+	// deterministic on all platforms, unlike rand()
+	unsigned int next();
+	int random(int min, int max);
+
+	QSizeF random_page_size();
+	QByteArray text_content(const QSizeF &size, int page);
+	QByteArray vector_content(const QSizeF &size);
+	QByteArray image_content(const QSizeF &size);
+	QByteArray link_annotations(const QSizeF &size);
+	// RGB pixels of a size x size image
+	QByteArray image_data(int size);
+
+	// builds the outline entries for pages [first, last), returns their ids
+	QList<int> add_outline(int parent, int first, int last, int depth, const QString &prefix);
+	QByteArray destination(int page) const;
+	QByteArray explicit_destination(int page, float y) const;
+
+	CorpusOptions options;
+	unsigned int state;
+	PdfWriter pdf;
+	QList<int> page_ids;
+	QList<QSizeF> page_sizes;
+	QList<int> image_ids; // a few variants, shared by all pages
+};
+
+#endif
+
@@ -0,0 +1,131 @@
+#include <QCoreApplication>
+#include <QString>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include "generator.h"
+
+using namespace std;
+
+
+static void print_help(char *name) {
+	CorpusOptions defaults;
+	cout << "Usage:" << endl;
+	cout << "  " << name << " [OPTIONS] FILE" << endl;
+	cout << endl;
+	cout << "Options:" << endl;
+	cout << "  -n, --pages NUM       Number of pages (" << defaults.pages << ")" << endl;
+	cout << "  -t, --text NUM        Lines of text per page (" << defaults.text_lines << ")" << endl;
+	cout << "  -c, --columns NUM     Text columns per page (" << defaults.text_columns << ")" << endl;
+	cout << "  -p, --paths NUM       Vector paths per page (" << defaults.paths << ")" << endl;
+	cout << "  -i, --images NUM      Raster images per page (" << defaults.images << ")" << endl;
+	cout << "  --image-size PX       Width and height of the images (" << defaults.image_size << ")" << endl;
+	cout << "  -l, --links NUM       Links per page (" << defaults.links << ")" << endl;
+	cout << "  -d, --toc-depth NUM   Depth of the outline, 0 for none (" << defaults.toc_depth << ")" << endl;
+	cout << "  -m, --mixed-sizes     Use different page sizes" << endl;
+	cout << "  --named-dests         Link to named destinations" << endl;
+	cout << "  -s, --seed NUM        Seed for the random content (" << defaults.seed << ")" << endl;
+	cout << "  -h, --help            Print this help and exit" << endl;
+}
+
+static bool parse_int(const char *arg, int *value) {
+	char *end;
+	long v = strtol(arg, &end, 10);
+	if (*arg == '\0' || *end != '\0' || v < 0) {
+		cerr << "invalid number " << arg << endl;
+		return false;
+	}
+	*value = v;
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	QCoreApplication app(argc, argv);
+
+	struct option long_options[] = {
+		{"pages",		required_argument,	NULL,	'n'},
+		{"text",		required_argument,	NULL,	't'},
+		{"columns",		required_argument,	NULL,	'c'},
+		{"paths",		required_argument,	NULL,	'p'},
+		{"images",		required_argument,	NULL,	'i'},
+		{"image-size",	required_argument,	NULL,	0},
+		{"links",		required_argument,	NULL,	'l'},
+		{"toc-depth",	required_argument,	NULL,	'd'},
+		{"mixed-sizes",	no_argument,		NULL,	'm'},
+		{"named-dests",	no_argument,		NULL,	0},
+		{"seed",		required_argument,	NULL,	's'},
+		{"help",		no_argument,		NULL,	'h'},
+		{NULL, 0, NULL, 0}
+	};
+	CorpusOptions options;
+	int option_index = 0;
+	while (1) {
+		int c = getopt_long(argc, argv, "n:t:c:p:i:l:d:ms:h", long_options, &option_index);
+		if (c == -1) {
+			break;
+		}
+		bool ok = true;
+		switch (c) {
+			case 0: {
+				const char *option_name = long_options[option_index].name;
+				if (!strcmp(option_name, "image-size")) {
+					ok = parse_int(optarg, &options.image_size) && options.image_size > 0;
+				} else if (!strcmp(option_name, "named-dests")) {
+					options.named_dests = true;
+				}
+				break;
+			}
+			case 'n':
+				ok = parse_int(optarg, &options.pages) && options.pages > 0;
+				break;
+			case 't':
+				ok = parse_int(optarg, &options.text_lines);
+				break;
+			case 'c':
+				ok = parse_int(optarg, &options.text_columns) && options.text_columns > 0;
+				break;
+			case 'p':
+				ok = parse_int(optarg, &options.paths);
+				break;
+			case 'i':
+				ok = parse_int(optarg, &options.images);
+				break;
+			case 'l':
+				ok = parse_int(optarg, &options.links);
+				break;
+			case 'd':
+				ok = parse_int(optarg, &options.toc_depth);
+				break;
+			case 'm':
+				options.mixed_sizes = true;
+				break;
+			case 's': {
+				int seed;
+				ok = parse_int(optarg, &seed);
+				options.seed = seed;
+				break;
+			}
+			case 'h':
+				print_help(argv[0]);
+				return 0;
+			default:
+				// getopt prints an error message
+				return 1;
+		}
+		if (!ok) {
+			return 1;
+		}
+	}
+	if (optind != argc - 1) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	CorpusGenerator generator(options);
+	if (!generator.generate(QString::fromLocal8Bit(argv[optind]))) {
+		return 1;
+	}
+	return 0;
+}
+
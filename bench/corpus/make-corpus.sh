@@ -0,0 +1,22 @@
+#!/bin/sh
+# generates the standard benchmark inputs into DIR (default: corpus)
+# usage: make-corpus.sh [DIR]
+
+gen=${KATARAKT_CORPUS:-$(dirname "$0")/katarakt-corpus}
+dir=${1:-corpus}
+mkdir -p "$dir" || exit 1
+
+run() {
+	name=$1
+	shift
+	"$gen" "$@" "$dir/$name.pdf" || exit 1
+	echo "$dir/$name.pdf"
+}
+
+run small      -n 10
+run text       -n 500 -t 60 -p 0 -i 0 -l 0
+run columns    -n 200 -t 120 -c 2 -p 0 -i 0
+run vector     -n 200 -t 10 -p 500 -i 0
+run images     -n 200 -t 10 -p 0 -i 4 --image-size 1024
+run mixed      -n 300 -m
+run toc        -n 1000 -t 20 -p 5 -i 0 -d 5 --named-dests
@@ -0,0 +1,92 @@
+#include <QFile>
+#include <iostream>
+#include "pdfwriter.h"
+
+using namespace std;
+
+
+PdfWriter::PdfWriter() {
+}
+
+int PdfWriter::reserve() {
+	objects.push_back(QByteArray());
+	return objects.size();
+}
+
+void PdfWriter::set_object(int id, const QByteArray &body) {
+	objects[id - 1] = body;
+}
+
+int PdfWriter::add_object(const QByteArray &body) {
+	int id = reserve();
+	set_object(id, body);
+	return id;
+}
+
+int PdfWriter::add_stream(const QByteArray &dict, const QByteArray &data, bool compress) {
+	QByteArray payload = data;
+	QByteArray filter;
+	if (compress) {
+		// qCompress prepends the uncompressed size (4 bytes), the rest is a zlib stream
+		payload = qCompress(data).mid(4);
+		filter = "/Filter /FlateDecode ";
+	}
+	QByteArray body = "<< " + dict + " " + filter + "/Length " + QByteArray::number(payload.size()) + " >>\nstream\n";
+	body += payload;
+	body += "\nendstream";
+	return add_object(body);
+}
+
+bool PdfWriter::save(const QString &file, int root) const {
+	QFile f(file);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		cerr << "failed to open " << file.toUtf8().constData() << endl;
+		return false;
+	}
+
+	QByteArray out = "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n";
+	QList<int> offsets;
+	for (int i = 0; i < objects.size(); i++) {
+		offsets.push_back(out.size());
+		out += QByteArray::number(i + 1) + " 0 obj\n";
+		out += objects[i];
+		out += "\nendobj\n";
+	}
+
+	int xref = out.size();
+	out += "xref\n0 " + QByteArray::number(objects.size() + 1) + "\n";
+	out += "0000000000 65535 f \n";
+	for (int i = 0; i < offsets.size(); i++) {
+		// each entry must be exactly 20 bytes
+		out += QByteArray::number(offsets[i]).rightJustified(10, '0') + " 00000 n \n";
+	}
+	out += "trailer\n<< /Size " + QByteArray::number(objects.size() + 1) +
+		" /Root " + ref(root) + " >>\n";
+	out += "startxref\n" + QByteArray::number(xref) + "\n%%EOF\n";
+
+	if (f.write(out) != out.size()) {
+		cerr << "failed to write " << file.toUtf8().constData() << endl;
+		return false;
+	}
+	return true;
+}
+
+QByteArray PdfWriter::ref(int id) {
+	return QByteArray::number(id) + " 0 R";
+}
+
+QByteArray PdfWriter::string(const QString &text) {
+	// Helvetica uses WinAnsiEncoding/StandardEncoding, stay within latin1
+	QByteArray in = text.toLatin1();
+	QByteArray out = "(";
+	for (int i = 0; i < in.size(); i++) {
+		char c = in[i];
+		if (c == '(' || c == ')' || c == '\\') {
+			out += '\\';
+		}
+		out += c;
+	}
+	out += ")";
+	return out;
+}
+
@@ -0,0 +1,32 @@
+#ifndef PDFWRITER_H
+#define PDFWRITER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+
+// minimal PDF 1.4 writer, objects are kept in memory until save()
+class PdfWriter {
+public:
+	PdfWriter();
+
+	// returns a new object id, the object must be set before saving
+	int reserve();
+	void set_object(int id, const QByteArray &body);
+	int add_object(const QByteArray &body);
+	// dict contains additional dictionary entries without << >>
+	int add_stream(const QByteArray &dict, const QByteArray &data, bool compress = true);
+
+	bool save(const QString &file, int root) const;
+
+	static QByteArray ref(int id);
+	// escapes a string for use in ( )
+	static QByteArray string(const QString &text);
+
+private:
+	QList<QByteArray> objects; // index = id - 1
+};
+
+#endif
+
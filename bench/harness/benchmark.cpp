@@ -0,0 +1,240 @@
+#include <QApplication>
+#include <QPainter>
+#include <QEventLoop>
+#include <QMetaObject>
+#include <iostream>
+#include <cstdlib>
+#include <sys/resource.h>
+#include "benchmark.h"
+#include "viewer.h"
+#include "canvas.h"
+#include "resourcemanager.h"
+#include "stats.h"
+#include "layout/layout.h"
+
+using namespace std;
+
+
+// give up waiting for the worker after this many milliseconds
+static const int settle_timeout = 30000;
+
+
+Benchmark::Benchmark(const QString &file, int width, int height) :
+		file(file),
+		buffer(width, height, QImage::Format_ARGB32_Premultiplied),
+		first_frame(-1),
+		motion_frames(0),
+		motion_time(0),
+		max_frame_time(0),
+		settle_count(0),
+		settle_time(0),
+		timeouts(0),
+		end(0) {
+	RenderStats::get_instance()->reset();
+	heartbeat.setInterval(10);
+	heartbeat.start();
+
+	start = RenderStats::now();
+	viewer = new Viewer(file);
+	if (!is_valid()) {
+		return;
+	}
+	// the viewer is never shown, so there are no resize events
+	get_layout()->resize(width, height);
+}
+
+Benchmark::~Benchmark() {
+	delete viewer;
+}
+
+bool Benchmark::is_valid() const {
+	return viewer->is_valid() && viewer->get_res()->is_valid();
+}
+
+bool Benchmark::run(const QStringList &script) {
+	// time to first frame
+	if (!settle()) {
+		cerr << file.toUtf8().constData() << ": timeout waiting for the first frame" << endl;
+	}
+	first_frame = RenderStats::now() - start;
+
+	Q_FOREACH(const QString &line, script) {
+		if (!execute(line)) {
+			cerr << "invalid command: " << line.toUtf8().constData() << endl;
+			return false;
+		}
+	}
+	end = RenderStats::now();
+	return true;
+}
+
+bool Benchmark::execute(const QString &line) {
+#if QT_VERSION >= 0x050e00
+	QStringList args = line.split(QChar::fromLatin1(' '), Qt::SkipEmptyParts);
+#else
+	QStringList args = line.split(QChar::fromLatin1(' '), QString::SkipEmptyParts);
+#endif
+	if (args.isEmpty() || args[0].startsWith(QChar::fromLatin1('#'))) {
+		return true;
+	}
+	QString command = args.takeFirst();
+	bool ok = true;
+
+	if (command == QString::fromUtf8("scroll") && args.size() == 3) {
+		// scroll DX DY FRAMES, spreads the distance over FRAMES frames
+		int dx = args[0].toInt(&ok);
+		int dy = ok ? args[1].toInt(&ok) : 0;
+		int frames = ok ? args[2].toInt(&ok) : 0;
+		if (!ok || frames <= 0) {
+			return false;
+		}
+		for (int i = 0; i < frames; i++) {
+			int step_x = dx * (i + 1) / frames - dx * i / frames;
+			int step_y = dy * (i + 1) / frames - dy * i / frames;
+			viewer->get_canvas()->notify_motion();
+			get_layout()->scroll_smooth(step_x, step_y);
+			frame(true);
+		}
+	} else if (command == QString::fromUtf8("zoom") && args.size() == 1) {
+		// zoom STEPS, one frame per step
+		int steps = args[0].toInt(&ok);
+		if (!ok) {
+			return false;
+		}
+		for (int i = 0; i < abs(steps); i++) {
+			viewer->get_canvas()->notify_motion();
+			get_layout()->set_zoom(steps > 0 ? 1 : -1);
+			frame(true);
+		}
+	} else if (command == QString::fromUtf8("jump") && args.size() == 1) {
+		// jump PAGE, counting from 1
+		int page = args[0].toInt(&ok);
+		if (!ok) {
+			return false;
+		}
+		get_layout()->scroll_page_top_jump(page - 1, false);
+		frame(true);
+	} else if (command == QString::fromUtf8("columns") && args.size() == 1) {
+		int columns = args[0].toInt(&ok);
+		if (!ok) {
+			return false;
+		}
+		get_layout()->set_columns(columns, false);
+		frame(true);
+	} else if (command == QString::fromUtf8("layout") && args.size() == 1) {
+		if (args[0] == QString::fromUtf8("single")) {
+			set_layout("set_single_layout");
+		} else if (args[0] == QString::fromUtf8("grid")) {
+			set_layout("set_grid_layout");
+		} else {
+			return false;
+		}
+		frame(true);
+	} else if (command == QString::fromUtf8("settle") && args.isEmpty()) {
+		qint64 t = RenderStats::now();
+		if (!settle()) {
+			timeouts++;
+		}
+		settle_time += RenderStats::now() - t;
+		settle_count++;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+void Benchmark::frame(bool moving) {
+	qint64 t = RenderStats::now();
+	{
+		QPainter painter(&buffer);
+		painter.fillRect(buffer.rect(), Qt::black);
+		get_layout()->render(&painter);
+	}
+	t = RenderStats::now() - t;
+
+	if (moving) {
+		motion_frames++;
+		motion_time += t;
+		if (t > max_frame_time) {
+			max_frame_time = t;
+		}
+	}
+	QApplication::processEvents();
+}
+
+bool Benchmark::frame_complete() const {
+	ResourceManager *res = viewer->get_res();
+	for (int page = 0; page < res->get_page_count(); page++) {
+		QRect r = get_layout()->get_page_rect(page);
+		if (r.isEmpty()) {
+			continue;
+		}
+		// the benchmark only uses layouts with render index 0
+		// get_page() would request renders and count cache accesses
+		if (!res->is_page_ready(page, r.width(), 0)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Benchmark::settle() {
+	qint64 timeout = RenderStats::now() + settle_timeout * 1000000LL;
+	while (RenderStats::now() < timeout) {
+		frame(false);
+		if (frame_complete()) {
+			return true;
+		}
+		// sleep until a page is rendered or the heartbeat fires
+		QApplication::processEvents(QEventLoop::WaitForMoreEvents);
+	}
+	return false;
+}
+
+Layout *Benchmark::get_layout() const {
+	return viewer->get_canvas()->get_layout();
+}
+
+void Benchmark::set_layout(const char *slot) {
+	QMetaObject::invokeMethod(viewer->get_canvas(), slot);
+	get_layout()->resize(buffer.width(), buffer.height());
+}
+
+void Benchmark::print_report() const {
+	RenderStats *stats = RenderStats::get_instance();
+	stats->set_memory_usage(viewer->get_res()->get_memory_usage());
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	double total = (end - start) / 1e9;
+	qint64 rendered = stats->get_count(RenderStats::Render);
+	double render_time = stats->get_total(RenderStats::Render) / 1e9;
+
+	cout << "file: " << file.toUtf8().constData() << endl;
+	cout << "  time to first frame: " << first_frame / 1e6 << " ms" << endl;
+	if (motion_frames > 0) {
+		cout << "  frames: " << motion_frames
+			<< ", " << motion_frames / (motion_time / 1e9) << " fps"
+			<< ", max " << max_frame_time / 1e6 << " ms" << endl;
+	}
+	if (settle_count > 0) {
+		cout << "  settle: " << settle_time / 1e6 / settle_count << " ms avg";
+		if (timeouts > 0) {
+			cout << ", " << timeouts << " timeouts";
+		}
+		cout << endl;
+	}
+	cout << "  pages rendered: " << rendered;
+	if (total > 0) {
+		cout << ", " << rendered / total << " pages/s";
+	}
+	if (render_time > 0) {
+		cout << " (" << rendered / render_time << " pages/s in poppler)";
+	}
+	cout << endl;
+	// ru_maxrss is in kilobytes and covers the whole process
+	cout << "  peak memory: " << usage.ru_maxrss / 1024 << " MB" << endl;
+	cout << "  stats: " << stats->to_json().toUtf8().constData() << endl;
+}
+
@@ -0,0 +1,57 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QString>
+#include <QStringList>
+#include <QImage>
+#include <QTimer>
+
+
+class Viewer;
+class Layout;
+
+
+// drives a hidden Viewer through a script and measures the render pipeline
+class Benchmark {
+public:
+	Benchmark(const QString &file, int width, int height);
+	~Benchmark();
+
+	bool is_valid() const;
+
+	// returns false on script errors
+	bool run(const QStringList &script);
+	void print_report() const;
+
+private:
+	bool execute(const QString &line);
+
+	// paints the current layout into the frame buffer
+	void frame(bool moving);
+	// all visible pages are rendered at full quality
+	bool frame_complete() const;
+	// paints until the view is complete, returns false on timeout
+	bool settle();
+
+	Layout *get_layout() const;
+	void set_layout(const char *slot);
+
+	QString file;
+	Viewer *viewer;
+	QImage buffer;
+	QTimer heartbeat; // wakes the event loop while waiting for the worker
+
+	// measurements in nanoseconds
+	qint64 start;
+	qint64 first_frame;
+	int motion_frames;
+	qint64 motion_time;
+	qint64 max_frame_time;
+	int settle_count;
+	qint64 settle_time;
+	int timeouts;
+	qint64 end;
+};
+
+#endif
+
@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET = katarakt-bench
+DEPENDPATH += .
+INCLUDEPATH += . ../../src
+include(../../katarakt.pri)
+
+HEADERS +=  benchmark.h
+SOURCES +=  main.cpp benchmark.cpp
@@ -0,0 +1,139 @@
+#include <QApplication>
+#include <QSettings>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#include <iostream>
+#include <cstdio>
+#include <getopt.h>
+#include "benchmark.h"
+
+using namespace std;
+
+
+// used when no script is given
+static const char *default_script[] = {
+	"layout single",
+	"scroll 0 -20000 200",
+	"settle",
+	"zoom 3",
+	"settle",
+	"zoom -3",
+	"jump 1",
+	"settle",
+	"layout grid",
+	"columns 3",
+	"settle",
+	"scroll 0 -20000 200",
+	"settle",
+	"zoom -5",
+	"settle",
+	NULL
+};
+
+static void print_help(char *name) {
+	cout << "Usage:" << endl;
+	cout << "  " << name << " [OPTIONS] FILE..." << endl;
+	cout << endl;
+	cout << "Options:" << endl;
+	cout << "  -s, --script FILE    Read the commands from FILE" << endl;
+	cout << "  -g, --geometry WxH   Size of the offscreen view, default 1280x800" << endl;
+	cout << "  -u, --user-config    Use the user's katarakt.ini instead of the defaults" << endl;
+	cout << "  -h, --help           Print this help and exit" << endl;
+	cout << endl;
+	cout << "Script commands, one per line:" << endl;
+	cout << "  layout single|grid   Switch the layout" << endl;
+	cout << "  scroll DX DY FRAMES  Scroll by DX, DY pixels over FRAMES frames" << endl;
+	cout << "  zoom STEPS           Zoom in (or out if negative), one frame per step" << endl;
+	cout << "  columns N            Set the number of grid columns" << endl;
+	cout << "  jump PAGE            Jump to PAGE" << endl;
+	cout << "  settle               Wait until all visible pages are rendered" << endl;
+}
+
+int main(int argc, char *argv[]) {
+#if QT_VERSION >= 0x050000
+	// render without a display unless told otherwise
+	if (qgetenv("QT_QPA_PLATFORM").isEmpty()) {
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	}
+#endif
+	QApplication app(argc, argv);
+
+	struct option long_options[] = {
+		{"script",		required_argument,	NULL,	's'},
+		{"geometry",	required_argument,	NULL,	'g'},
+		{"user-config",	no_argument,		NULL,	'u'},
+		{"help",		no_argument,		NULL,	'h'},
+		{NULL, 0, NULL, 0}
+	};
+	QStringList script;
+	int width = 1280, height = 800;
+	bool user_config = false;
+	while (1) {
+		int c = getopt_long(argc, argv, "s:g:uh", long_options, NULL);
+		if (c == -1) {
+			break;
+		}
+		switch (c) {
+			case 's': {
+				QFile f(QString::fromLocal8Bit(optarg));
+				if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+					cerr << "failed to open " << optarg << endl;
+					return 1;
+				}
+				QTextStream in(&f);
+				while (!in.atEnd()) {
+					script << in.readLine();
+				}
+				break;
+			}
+			case 'g':
+				if (sscanf(optarg, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+					cerr << "invalid geometry " << optarg << endl;
+					return 1;
+				}
+				break;
+			case 'u':
+				user_config = true;
+				break;
+			case 'h':
+				print_help(argv[0]);
+				return 0;
+			default:
+				// getopt prints an error message
+				return 1;
+		}
+	}
+	if (optind >= argc) {
+		print_help(argv[0]);
+		return 1;
+	}
+	if (script.isEmpty()) {
+		for (int i = 0; default_script[i] != NULL; i++) {
+			script << QString::fromUtf8(default_script[i]);
+		}
+	}
+
+	// results should not depend on the user's settings
+	if (!user_config) {
+		QSettings::setPath(QSettings::IniFormat, QSettings::UserScope,
+				QDir::tempPath() + QString::fromUtf8("/katarakt-bench"));
+	}
+
+	int ret = 0;
+	for (int i = optind; i < argc; i++) {
+		Benchmark bench(QString::fromLocal8Bit(argv[i]), width, height);
+		if (!bench.is_valid()) {
+			cerr << "failed to open " << argv[i] << endl;
+			ret = 1;
+			continue;
+		}
+		if (!bench.run(script)) {
+			return 1;
+		}
+		bench.print_report();
+	}
+	return ret;
+}
+
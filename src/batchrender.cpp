@@ -0,0 +1,278 @@
+#include <QCoreApplication>
+#include <QThread>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QStringList>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#if QT_VERSION >= 0x050000
+#	include <poppler-qt5.h>
+#else
+#	include <poppler-qt4.h>
+#endif
+#include "batchrender.h"
+#include "resourcemanager.h"
+#include "util.h"
+
+using namespace std;
+
+
+struct BatchOptions {
+	QString file;
+	QString output;
+	int width; // -1: use dpi
+	float dpi;
+	int rotation;
+	bool invert;
+	QList<int> pages;
+};
+
+
+// poppler renders one page at a time per document, so every thread opens its own
+class RenderThread : public QThread {
+public:
+	RenderThread(const BatchOptions &options, QAtomicInt *next, QAtomicInt *failed) :
+			options(options),
+			next(next),
+			failed(failed) {
+	}
+
+	void run() {
+		Poppler::Document *doc = Poppler::Document::load(options.file);
+		if (doc == NULL || doc->isLocked()) {
+			// poppler already prints a debug message
+			failed->ref();
+			delete doc;
+			return;
+		}
+		ResourceManager::set_render_hints(doc);
+
+		int digits = QString::number(doc->numPages()).length();
+		while (1) {
+			int i = next->fetchAndAddRelaxed(1);
+			if (i >= options.pages.size()) {
+				break;
+			}
+			int page = options.pages[i];
+			if (!render(doc, page, digits)) {
+				failed->ref();
+			}
+		}
+		delete doc;
+	}
+
+private:
+	bool render(Poppler::Document *doc, int page, int digits) {
+		Poppler::Page *p = doc->page(page);
+		if (p == NULL) {
+			cerr << "failed to load page " << page << endl;
+			return false;
+		}
+
+		float dpi = options.dpi;
+		if (options.width > 0) {
+			// width is given for the rotated page
+			QSizeF size = p->pageSizeF();
+			float page_width = options.rotation % 2 == 0 ? size.width() : size.height();
+			dpi = 72.0 * options.width / page_width;
+		}
+		QImage img = p->renderToImage(dpi, dpi, -1, -1, -1, -1,
+				static_cast<Poppler::Page::Rotation>(options.rotation));
+		delete p;
+		if (img.isNull()) {
+			cerr << "failed to render page " << page << endl;
+			return false;
+		}
+		if (options.invert) {
+			invert_image(&img);
+		}
+
+		QString file = options.output.arg(page + 1, digits, 10, QChar::fromLatin1('0'));
+		if (!img.save(file)) {
+			cerr << "failed to write " << file.toUtf8().constData() << endl;
+			return false;
+		}
+		return true;
+	}
+
+	const BatchOptions &options;
+	QAtomicInt *next;
+	QAtomicInt *failed;
+};
+
+
+static void print_help(char *name) {
+	cout << "Usage:" << endl;
+	cout << "  " << name << " --render [OPTIONS] FILE" << endl;
+	cout << endl;
+	cout << "Options:" << endl;
+	cout << "  -o, --output PATTERN   Output files, %1 is replaced by the page number" << endl;
+	cout << "                         (default: page-%1.png)" << endl;
+	cout << "  -w, --width PX         Width of the rendered pages" << endl;
+	cout << "  -d, --dpi DPI          Resolution if no width is given (default: 150)" << endl;
+	cout << "  -p, --pages RANGES     Pages to render, e.g. 1-3,7,10- (default: all)" << endl;
+	cout << "  -r, --rotate DEGREES   Rotate clockwise by 90, 180 or 270 degrees" << endl;
+	cout << "  -i, --invert           Render with inverted colors" << endl;
+	cout << "  -j, --threads NUM      Number of render threads (default: number of cores)" << endl;
+	cout << "  -h, --help             Print this help and exit" << endl;
+}
+
+// parses 1-based page ranges like 1-3,7,10- into 0-based page numbers
+static bool parse_pages(const QString &ranges, int page_count, QList<int> *pages) {
+	Q_FOREACH(const QString &range, ranges.split(QChar::fromLatin1(','))) {
+		QStringList bounds = range.split(QChar::fromLatin1('-'));
+		if (bounds.size() > 2) {
+			return false;
+		}
+		bool ok = true;
+		int first = bounds[0].isEmpty() ? 1 : bounds[0].toInt(&ok);
+		int last = first;
+		if (ok && bounds.size() == 2) {
+			last = bounds[1].isEmpty() ? page_count : bounds[1].toInt(&ok);
+		}
+		if (!ok || first < 1 || last > page_count || first > last) {
+			return false;
+		}
+		for (int page = first; page <= last; page++) {
+			pages->push_back(page - 1);
+		}
+	}
+	return true;
+}
+
+int batch_render(int argc, char *argv[]) {
+	QCoreApplication app(argc, argv);
+
+	struct option long_options[] = {
+		{"output",		required_argument,	NULL,	'o'},
+		{"width",		required_argument,	NULL,	'w'},
+		{"dpi",			required_argument,	NULL,	'd'},
+		{"pages",		required_argument,	NULL,	'p'},
+		{"rotate",		required_argument,	NULL,	'r'},
+		{"invert",		no_argument,		NULL,	'i'},
+		{"threads",		required_argument,	NULL,	'j'},
+		{"help",		no_argument,		NULL,	'h'},
+		{NULL, 0, NULL, 0}
+	};
+	BatchOptions options;
+	options.output = QString::fromUtf8("page-%1.png");
+	options.width = -1;
+	options.dpi = 150;
+	options.rotation = 0;
+	options.invert = false;
+	QString ranges;
+	int threads = QThread::idealThreadCount();
+
+	while (1) {
+		int c = getopt_long(argc, argv, "o:w:d:p:r:ij:h", long_options, NULL);
+		if (c == -1) {
+			break;
+		}
+		switch (c) {
+			case 'o':
+				options.output = QString::fromLocal8Bit(optarg);
+				break;
+			case 'w':
+				options.width = atoi(optarg);
+				if (options.width <= 0) {
+					cerr << "invalid width " << optarg << endl;
+					return 1;
+				}
+				break;
+			case 'd':
+				options.dpi = atof(optarg);
+				if (options.dpi <= 0) {
+					cerr << "invalid dpi " << optarg << endl;
+					return 1;
+				}
+				break;
+			case 'p':
+				ranges = QString::fromLocal8Bit(optarg);
+				break;
+			case 'r': {
+				int degrees = atoi(optarg);
+				if (degrees % 90 != 0) {
+					cerr << "invalid rotation " << optarg << endl;
+					return 1;
+				}
+				options.rotation = ((degrees / 90) % 4 + 4) % 4;
+				break;
+			}
+			case 'i':
+				options.invert = true;
+				break;
+			case 'j':
+				threads = atoi(optarg);
+				if (threads <= 0) {
+					cerr << "invalid number of threads " << optarg << endl;
+					return 1;
+				}
+				break;
+			case 'h':
+				print_help(argv[0]);
+				return 0;
+			default:
+				// getopt prints an error message
+				return 1;
+		}
+	}
+	if (optind != argc - 1) {
+		print_help(argv[0]);
+		return 1;
+	}
+	options.file = QString::fromLocal8Bit(argv[optind]);
+	if (!options.output.contains(QString::fromUtf8("%1"))) {
+		cerr << "the output pattern must contain %1" << endl;
+		return 1;
+	}
+
+	// only for the page count
+	Poppler::Document *doc = Poppler::Document::load(options.file);
+	if (doc == NULL || doc->isLocked()) {
+		// poppler already prints a debug message
+		delete doc;
+		return 1;
+	}
+	int page_count = doc->numPages();
+	delete doc;
+
+	if (ranges.isEmpty()) {
+		for (int page = 0; page < page_count; page++) {
+			options.pages.push_back(page);
+		}
+	} else if (!parse_pages(ranges, page_count, &options.pages)) {
+		cerr << "invalid page range " << ranges.toUtf8().constData() << endl;
+		return 1;
+	}
+	threads = qMin(threads, options.pages.size());
+
+	if (options.invert) {
+		// initialize the config values in invert_image() before going parallel
+		QImage img(1, 1, QImage::Format_RGB32);
+		invert_image(&img);
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	QAtomicInt next(0);
+	QAtomicInt failed(0);
+	QList<RenderThread *> workers;
+	for (int i = 0; i < threads; i++) {
+		workers.push_back(new RenderThread(options, &next, &failed));
+		workers.back()->start();
+	}
+	Q_FOREACH(RenderThread *worker, workers) {
+		worker->wait();
+		delete worker;
+	}
+
+	int errors = failed.fetchAndAddRelaxed(0);
+	cerr << "rendered " << options.pages.size() - errors << " pages in "
+		<< timer.elapsed() << " ms using " << threads << " threads" << endl;
+	return errors > 0 ? 1 : 0;
+}
+
@@ -0,0 +1,10 @@
+#ifndef BATCHRENDER_H
+#define BATCHRENDER_H
+
+
+// katarakt --render [OPTIONS] FILE
+// renders pages to image files on all cores without creating any widgets
+int batch_render(int argc, char *argv[]);
+
+#endif
+
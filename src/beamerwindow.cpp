@@ -66,6 +66,7 @@ void BeamerWindow::paintEvent(QPaintEvent * /*event*/) {
 #endif
 	QPainter painter(this);
 	painter.fillRect(rect(), QColor(0, 0, 0));
+	viewer->get_res()->begin_frame();
 	layout->render(&painter);
 }
 
@@ -100,8 +101,17 @@ void BeamerWindow::resizeEvent(QResizeEvent *event) {
 }
 
 void BeamerWindow::page_rendered(int page) {
-	if (layout->page_visible(page)) {
-		update();
+	if (!isVisible()) {
+		return;
 	}
+	// only repaint the new page
+	QRect r = layout->get_page_rect(page).intersected(rect());
+	if (!r.isEmpty()) {
+		update(r);
+	}
+}
+
+void BeamerWindow::text_extracted(int page) {
+	layout->text_extracted(page);
 }
 
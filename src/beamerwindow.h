@@ -35,6 +35,7 @@ protected:
 
 private slots:
 	void page_rendered(int page);
+	void text_extracted(int page);
 
 private:
 	Viewer *viewer;
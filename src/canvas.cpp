@@ -19,6 +19,9 @@
 #include "gotoline.h"
 #include "config.h"
 #include "beamerwindow.h"
+#include "scrollanimation.h"
+#include "stats.h"
+#include "trace.h"
 #include "util.h"
 
 using namespace std;
@@ -117,11 +120,28 @@ Canvas::Canvas(Viewer *v, QWidget *parent) :
 	hide_mouse_timer.setSingleShot(true);
 	connect(&hide_mouse_timer, SIGNAL(timeout()), this, SLOT(hide_mouse_pointer()), Qt::UniqueConnection);
 
+	motion_timer.setSingleShot(true);
+	motion_timer.setInterval(config->get_value("Settings/motion_settle_time").toInt());
+	connect(&motion_timer, SIGNAL(timeout()), this, SLOT(motion_settled()), Qt::UniqueConnection);
+
 	page_overlay = new QLabel(this);
 	page_overlay->setMargin(1);
 	page_overlay->setAutoFillBackground(true);
 	page_overlay->show();
 
+	stats_overlay = new QLabel(this);
+	stats_overlay->setMargin(1);
+	stats_overlay->setAutoFillBackground(true);
+	stats_overlay->hide();
+	stats_timer.setInterval(500);
+	connect(&stats_timer, SIGNAL(timeout()), this, SLOT(update_stats_overlay()), Qt::UniqueConnection);
+
+	scroll_animation = new ScrollAnimation(this);
+
+	select_timer.setSingleShot(true);
+	select_timer.setInterval(scroll_animation->get_frame_interval());
+	connect(&select_timer, SIGNAL(timeout()), this, SLOT(apply_selection()), Qt::UniqueConnection);
+
 	// setup beamer
 	BeamerWindow *beamer = viewer->get_beamer();
 	setup_keys(beamer);
@@ -135,6 +155,8 @@ Canvas::Canvas(Viewer *v, QWidget *parent) :
 }
 
 Canvas::~Canvas() {
+	delete scroll_animation;
+	delete stats_overlay;
 	delete page_overlay;
 	delete goto_line;
 	delete single_layout;
@@ -160,6 +182,8 @@ void Canvas::setup_keys(QWidget *base) {
 	add_action(base, "Keys/set_presenter_layout", SLOT(set_presenter_layout()), this);
 
 	add_action(base, "Keys/toggle_overlay", SLOT(toggle_overlay()), this);
+	add_action(base, "Keys/toggle_stats", SLOT(toggle_stats()), this);
+	add_action(base, "Keys/dump_stats", SLOT(dump_stats()), this);
 	add_action(base, "Keys/swap_selection_and_panning_buttons", SLOT(swap_selection_and_panning_buttons()), this);
 }
 
@@ -167,6 +191,10 @@ Layout *Canvas::get_layout() const {
 	return cur_layout;
 }
 
+ScrollAnimation *Canvas::get_scroll_animation() const {
+	return scroll_animation;
+}
+
 void Canvas::update_page_overlay() {
 	QString frozen_text;
 	if (viewer->get_beamer()->is_frozen()) {
@@ -178,9 +206,18 @@ void Canvas::update_page_overlay() {
 	page_overlay->setText(frozen_text + overlay_text);
 	page_overlay->adjustSize();
 	page_overlay->move(width() - page_overlay->width(), height() - page_overlay->height());
+	if (stats_overlay->isVisible()) {
+		stats_overlay->move(page_overlay->x() - stats_overlay->width(), height() - stats_overlay->height());
+	}
+}
+
+void Canvas::notify_motion() {
+	viewer->get_res()->set_motion(true);
+	motion_timer.start();
 }
 
 void Canvas::paintEvent(QPaintEvent * /*event*/) {
+	TRACE_SPAN("paint", "gui");
 #ifdef DEBUG
 	cerr << "redraw" << endl;
 #endif
@@ -190,6 +227,7 @@ void Canvas::paintEvent(QPaintEvent * /*event*/) {
 	} else {
 		painter.fillRect(rect(), background);
 	}
+	viewer->get_res()->begin_frame();
 	cur_layout->render(&painter);
 }
 
@@ -202,12 +240,14 @@ void Canvas::mousePressEvent(QMouseEvent *event) {
 		my_down = my;
 	}
 	if (drag_view_button != Qt::NoButton && event->button() == drag_view_button) {
+		scroll_animation->stop(); // grab the view
 		if (cursor().shape() != Qt::PointingHandCursor) { // TODO
 			setCursor(Qt::ClosedHandCursor);
 			last_cursor = Qt::BlankCursor;
 		}
 	}
 	if (select_text_button != Qt::NoButton && event->button() == select_text_button) {
+		select_timer.stop(); // drop the pending update of the previous selection
 		if (triple_click_possible) {
 			cur_layout->select(event->x(), event->y(), Selection::StartLine);
 			triple_click_possible = false;
@@ -238,6 +278,10 @@ void Canvas::mouseReleaseEvent(QMouseEvent *event) {
 		}
 	}
 
+	if (drag_view_button != Qt::NoButton && event->button() == drag_view_button) {
+		scroll_animation->release_drag();
+	}
+
 	if (drag_view_button == Qt::LeftButton) {
 		setCursor(Qt::OpenHandCursor);
 	} else {
@@ -246,6 +290,12 @@ void Canvas::mouseReleaseEvent(QMouseEvent *event) {
 	last_cursor = Qt::BlankCursor;
 
 	if (select_text_button != Qt::NoButton && event->button() == select_text_button) {
+		if (select_timer.isActive()) {
+			select_timer.stop();
+			apply_selection();
+		}
+		// the selection may have scrolled the view, don't estimate the next drag from it
+		scroll_animation->end_drag();
 		cur_layout->copy_selection_text();
 	}
 
@@ -261,7 +311,7 @@ void Canvas::mouseReleaseEvent(QMouseEvent *event) {
 
 void Canvas::mouseMoveEvent(QMouseEvent *event) {
 	if (drag_view_button != Qt::NoButton && event->buttons() & drag_view_button) {
-		cur_layout->scroll_smooth(event->x() - mx, event->y() - my);
+		scroll_animation->drag(event->x() - mx, event->y() - my);
 		mx = event->x();
 		my = event->y();
 
@@ -293,22 +343,25 @@ void Canvas::mouseMoveEvent(QMouseEvent *event) {
         }
 	}
 	if (select_text_button != Qt::NoButton && event->buttons() & select_text_button) {
-		cur_layout->select(event->x(), event->y(), Selection::End);
+		select_location = cur_layout->get_location_at(event->x(), event->y());
+		if (!select_timer.isActive()) {
+			select_timer.start();
+		}
 
 		// scrolling by dragging the selection
 		// TODO only scrolls when the mouse is moved
 		int margin = min(10, min(width() / 10, height() / 10));
 		if (event->x() < margin) {
-			cur_layout->scroll_smooth(min(margin - event->x(), margin) * 2, 0);
+			scroll_animation->drag(min(margin - event->x(), margin) * 2, 0);
 		}
 		if (event->x() > width() - margin) {
-			cur_layout->scroll_smooth(max(width() - event->x() - margin, -margin) * 2, 0);
+			scroll_animation->drag(max(width() - event->x() - margin, -margin) * 2, 0);
 		}
 		if (event->y() < margin) {
-			cur_layout->scroll_smooth(0, min(margin - event->y(), margin) * 2);
+			scroll_animation->drag(0, min(margin - event->y(), margin) * 2);
 		}
 		if (event->y() > height() - margin) {
-			cur_layout->scroll_smooth(0, max(height() - event->y() - margin, -margin) * 2);
+			scroll_animation->drag(0, max(height() - event->y() - margin, -margin) * 2);
 		}
 	}
 
@@ -317,6 +370,19 @@ void Canvas::mouseMoveEvent(QMouseEvent *event) {
 		setCursor(last_cursor);
 		last_cursor = Qt::BlankCursor;
 	}
+	// pointing hand above links, a lookup in the page's link index
+	if (click_link_button != Qt::NoButton && event->buttons() == 0) {
+		bool link = cur_layout->has_link_at(event->x(), event->y());
+		if (link && cursor().shape() != Qt::PointingHandCursor) {
+			setCursor(Qt::PointingHandCursor);
+		} else if (!link && cursor().shape() == Qt::PointingHandCursor) {
+			if (drag_view_button == Qt::LeftButton) {
+				setCursor(Qt::OpenHandCursor);
+			} else {
+				setCursor(Qt::IBeamCursor);
+			}
+		}
+	}
 	// auto-hide mouse pointer
 	if (event->buttons() == 0) {
 		if (hide_mouse_timeout > 0) {
@@ -334,17 +400,18 @@ void Canvas::wheelEvent(QWheelEvent *event) {
 		case Qt::NoModifier:
 			if (event->orientation() == Qt::Vertical) {
 				if (cur_layout->supports_smooth_scrolling()) {
-					cur_layout->scroll_smooth(0, d);
+					scroll_animation->scroll_kinetic(0, d);
 				} else {
 					cur_layout->scroll_page(-d / mouse_wheel_factor);
 				}
 			} else {
-				cur_layout->scroll_smooth(d, 0);
+				scroll_animation->scroll_kinetic(d, 0);
 			}
 			break;
 
 		// zoom
 		case Qt::ControlModifier:
+			notify_motion();
 			cur_layout->set_zoom(d / mouse_wheel_factor);
 			break;
 	}
@@ -367,10 +434,13 @@ void Canvas::resizeEvent(QResizeEvent *event) {
 	cur_layout->resize(event->size().width(), event->size().height());
 	goto_line->move(0, height() - goto_line->height());
 	page_overlay->move(width() - page_overlay->width(), height() - page_overlay->height());
+	stats_overlay->move(page_overlay->x() - stats_overlay->width(), height() - stats_overlay->height());
 }
 
 // primitive actions
 void Canvas::set_single_layout() {
+	scroll_animation->stop();
+	presenter_layout->stop_preload();
 	single_layout->activate(cur_layout);
 	cur_layout = single_layout;
 	update();
@@ -380,6 +450,8 @@ void Canvas::set_single_layout() {
 }
 
 void Canvas::set_grid_layout() {
+	scroll_animation->stop();
+	presenter_layout->stop_preload();
 	grid_layout->activate(cur_layout);
 	grid_layout->rebuild();
 	cur_layout = grid_layout;
@@ -390,6 +462,7 @@ void Canvas::set_grid_layout() {
 }
 
 void Canvas::set_presenter_layout() {
+	scroll_animation->stop();
 	presenter_layout->activate(cur_layout);
 	presenter_layout->rebuild();
 	cur_layout = presenter_layout;
@@ -413,6 +486,30 @@ void Canvas::toggle_overlay() {
 	page_overlay->setVisible(!page_overlay->isVisible());
 }
 
+void Canvas::toggle_stats() {
+	if (stats_overlay->isVisible()) {
+		stats_timer.stop();
+		stats_overlay->hide();
+	} else {
+		update_stats_overlay();
+		stats_overlay->show();
+		stats_timer.start();
+	}
+}
+
+void Canvas::dump_stats() {
+	RenderStats::get_instance()->set_memory_usage(viewer->get_res()->get_memory_usage());
+	cout << RenderStats::get_instance()->to_json().toUtf8().constData() << endl;
+}
+
+void Canvas::update_stats_overlay() {
+	RenderStats *stats = RenderStats::get_instance();
+	stats->set_memory_usage(viewer->get_res()->get_memory_usage());
+	stats_overlay->setText(stats->get_summary());
+	stats_overlay->adjustSize();
+	stats_overlay->move(page_overlay->x() - stats_overlay->width(), height() - stats_overlay->height());
+}
+
 void Canvas::focus_goto() {
 	goto_line->activateWindow();
 	goto_line->show();
@@ -451,11 +548,31 @@ void Canvas::set_search_visible(bool visible) {
 }
 
 void Canvas::page_rendered(int page) {
-	if (cur_layout->page_visible(page)) {
-		update();
+	// only repaint the new page
+	QRect r = cur_layout->get_page_rect(page).intersected(rect());
+	if (!r.isEmpty()) {
+		update(r);
 	}
 }
 
+void Canvas::motion_settled() {
+	viewer->get_res()->set_motion(false);
+	// request full quality renders for the drafts
+	update();
+	BeamerWindow *beamer = viewer->get_beamer();
+	if (beamer->isVisible()) {
+		beamer->update();
+	}
+}
+
+void Canvas::text_extracted(int page) {
+	cur_layout->text_extracted(page);
+}
+
+void Canvas::apply_selection() {
+	cur_layout->select(select_location, Selection::End);
+}
+
 void Canvas::goto_page() {
 	int page = goto_line->text().toInt() - 1;
 	goto_line->hide();
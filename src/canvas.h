@@ -8,6 +8,8 @@
 #include <QResizeEvent>
 #include <QList>
 #include <QTimer>
+#include <QPointF>
+#include <utility>
 #include <sys/socket.h>
 
 
@@ -17,6 +19,7 @@ class SingleLayout;
 class GridLayout;
 class PresenterLayout;
 class GotoLine;
+class ScrollAnimation;
 class QLabel;
 
 
@@ -33,9 +36,13 @@ public:
 	void set_search_visible(bool visible);
 
 	Layout *get_layout() const;
+	ScrollAnimation *get_scroll_animation() const;
 
 	void update_page_overlay();
 
+	// the view is moving, render cheap drafts until it settles
+	void notify_motion();
+
 protected:
 	// QT event handling
 	void paintEvent(QPaintEvent *event);
@@ -55,7 +62,11 @@ signals:
 
 private slots:
 	void page_rendered(int page);
+	void text_extracted(int page);
 	void goto_page();
+	void motion_settled();
+	void apply_selection();
+	void update_stats_overlay();
 
 	// primitive actions
 	void set_single_layout();
@@ -63,6 +74,8 @@ private slots:
 	void set_presenter_layout();
 
 	void toggle_overlay();
+	void toggle_stats();
+	void dump_stats();
 	void focus_goto();
 
 	void disable_triple_click();
@@ -81,6 +94,9 @@ private:
 
 	GotoLine *goto_line;
 	QLabel *page_overlay;
+	QLabel *stats_overlay;
+	QTimer stats_timer;
+	ScrollAnimation *scroll_animation;
 
 	int mx, my;
 	int mx_down, my_down;
@@ -90,6 +106,13 @@ private:
 	QTimer hide_mouse_timer;
 	Qt::CursorShape last_cursor;
 
+	QTimer motion_timer;
+
+	// coalesces selection updates to once per frame; the document location
+	// is taken when the event is seen, before the drag scrolls the view
+	QTimer select_timer;
+	std::pair<int, QPointF> select_location;
+
 	bool valid;
 
 	// config options
@@ -53,6 +53,8 @@ void CFG::init_defaults() {
 	default_setting("Settings/select_text_button", 1);
 	default_setting("Settings/hide_mouse_timeout", 2000);
 	default_setting("Settings/smooth_scroll_delta", 30); // pixel scroll offset
+	default_setting("Settings/scroll_animation_time", 100); // milliseconds, 0 disables easing
+	default_setting("Settings/kinetic_friction", 6.0); // deceleration of inertial scrolling, 0 disables it
 	default_setting("Settings/screen_scroll_factor", 0.9); // creates overlap for scrolling 1 screen down, should be <= 1
 	default_setting("Settings/jump_padding", 0.2); // must be <= 0.5
 	default_setting("Settings/rect_margin", 2);
@@ -74,7 +76,13 @@ void CFG::init_defaults() {
 	default_setting("Settings/inverted_color_brightening", 0.15);
 	default_setting("Settings/mouse_wheel_factor", 120); // (qt-)delta for turning the mouse wheel 1 click
 	default_setting("Settings/thumbnail_filter", true); // filter when creating thumbnail image
-	default_setting("Settings/thumbnail_size", 32);
+	default_setting("Settings/thumbnail_pixels", 8192); // about 64x128
+	default_setting("Settings/thumbnail_disk_cache", false);
+	default_setting("Settings/motion_dpi_factor", 0.5); // resolution of drafts while moving, 1 disables drafts
+	default_setting("Settings/motion_settle_time", 150); // milliseconds without movement until pages are rendered in full quality
+	default_setting("Settings/text_cache_size", 32); // MiB of text and links kept for pages out of view
+	default_setting("Settings/download_cache", true); // keep downloaded documents, revalidate on the next download
+	default_setting("Settings/presenter_preload_size", 512); // MiB of slide images the presenter layout may preload, 0 disables it
 
 	// keys
 	// movement
@@ -115,6 +123,8 @@ void CFG::init_defaults() {
 	default_key("Keys/rotate_right", ".");
 	// viewer
 	default_key("Keys/toggle_overlay", "T");
+	default_key("Keys/toggle_stats", "Shift+T");
+	default_key("Keys/dump_stats", "Ctrl+Shift+T");
 	default_key("Keys/quit", "Q", "W,E,E,E");
 	default_key("Keys/close_search", "Esc");
 	default_key("Keys/invert_colors", "I");
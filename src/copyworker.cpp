@@ -0,0 +1,124 @@
+#include "copyworker.h"
+#include "trace.h"
+#include <iostream>
+#if QT_VERSION >= 0x050000
+#	include <poppler-qt5.h>
+#else
+#	include <poppler-qt4.h>
+#endif
+
+using namespace std;
+
+
+CopyWorker::CopyWorker(const QString &file, const QByteArray &password) :
+		file(file),
+		password(password),
+		doc(NULL),
+		current_mode(-1),
+		stop(false),
+		die(false) {
+}
+
+void CopyWorker::enqueue(const CopyJob &job) {
+	job_mutex.lock();
+	// the running job is outdated as well
+	if (current_mode == job.mode) {
+		stop = true;
+	}
+	// replace in place, the pending job's token may already be taken by
+	// run(), which then waits for job_mutex
+	for (list<CopyJob>::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+		if (it->mode == job.mode) {
+			*it = job;
+			job_mutex.unlock();
+			return;
+		}
+	}
+	jobs.push_back(job);
+	job_mutex.unlock();
+	job_semaphore.release(1);
+}
+
+void CopyWorker::join() {
+	die = true;
+	stop = true;
+	job_semaphore.release(1);
+	wait();
+}
+
+void CopyWorker::run() {
+	Trace::get_instance()->set_thread_name("copy worker");
+	while (1) {
+		job_semaphore.acquire(1);
+		if (die) {
+			break;
+		}
+
+		job_mutex.lock();
+		CopyJob job = jobs.front();
+		jobs.pop_front();
+		current_mode = job.mode;
+		stop = false;
+		job_mutex.unlock();
+
+		QString text = build_text(job);
+
+		job_mutex.lock();
+		if (!stop) {
+			emit text_copied(text, job.mode);
+		}
+		current_mode = -1;
+		job_mutex.unlock();
+	}
+	// loaded in this thread, closed in this thread
+	if (doc != NULL) {
+		delete doc;
+		doc = NULL;
+	}
+}
+
+QString CopyWorker::build_text(const CopyJob &job) {
+	TRACE_SPAN("copy selection", "copy");
+	QString text;
+	if (!job.selection.is_active()) {
+		return text;
+	}
+	int from = job.selection.get_cursor(true).page;
+	int to = job.selection.get_cursor(false).page;
+
+	// extract the missing pages with the same layout analysis as the
+	// render worker, the cursor indices stay valid
+	map<int, TextLayer> layers = job.layers;
+	int size = 0;
+	for (int page = from; page <= to && !stop; page++) {
+		map<int, TextLayer>::iterator it = layers.find(page);
+		if (it == layers.end()) {
+			if (doc == NULL) {
+				doc = Poppler::Document::load(file, QByteArray(), password);
+			}
+			if (doc == NULL || doc->isLocked()) {
+				return QString();
+			}
+			TRACE_SPAN("extract text", "copy", page);
+			Poppler::Page *p = doc->page(page);
+			if (p == NULL) {
+				cerr << "failed to load page " << page << endl;
+				continue;
+			}
+			it = layers.insert(make_pair(page, TextLayer(p->textList()))).first;
+			delete p;
+		}
+		// upper bound: all characters, a space or tab per word, a line break per line
+		size += it->second.get_char_count() + it->second.get_word_count() + it->second.get_line_count();
+	}
+	if (stop) {
+		return QString();
+	}
+
+	text.reserve(size);
+	for (map<int, TextLayer>::const_iterator it = layers.begin(); it != layers.end() && !stop; ++it) {
+		job.selection.append_selection_text(text, it->first, &it->second);
+	}
+	return text;
+}
+
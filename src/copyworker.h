@@ -0,0 +1,61 @@
+#ifndef COPYWORKER_H
+#define COPYWORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QSemaphore>
+#include <QString>
+#include <QByteArray>
+#include <list>
+#include <map>
+#include "selection.h"
+#include "textlayer.h"
+
+namespace Poppler {
+	class Document;
+}
+
+
+class CopyJob {
+public:
+	MouseSelection selection;
+	// shallow copies of the cached text, missing pages are extracted
+	std::map<int, TextLayer> layers;
+	int mode; // QClipboard::Mode
+};
+
+
+// turns selections into text without blocking the gui thread
+class CopyWorker : public QThread {
+	Q_OBJECT
+
+public:
+	CopyWorker(const QString &file, const QByteArray &password);
+	void run();
+
+	// replaces a pending job for the same clipboard mode
+	void enqueue(const CopyJob &job);
+	void join();
+
+signals:
+	void text_copied(const QString &text, int mode);
+
+private:
+	QString build_text(const CopyJob &job);
+
+	QString file;
+	QByteArray password;
+	// own document, loaded on the first page without cached text
+	Poppler::Document *doc;
+
+	QMutex job_mutex;
+	QSemaphore job_semaphore;
+	std::list<CopyJob> jobs;
+	int current_mode;
+
+	volatile bool stop;
+	volatile bool die;
+};
+
+#endif
+
@@ -1,69 +1,280 @@
 #include "download.h"
 #include <iostream>
 #include <QEventLoop>
-#include <QUrl>
 #include <QNetworkRequest>
 #include <QNetworkReply>
-#include <QByteArray>
+#include <QRegExp>
 #include <QDir>
 #include <QFileInfo>
+#include <QTemporaryFile>
+#include <QSettings>
+#include <QCryptographicHash>
+#include <cstdio>
+#include "config.h"
+#include "util.h"
 
 using namespace std;
 
 
+// how often an interrupted download is resumed
+#define MAX_RETRIES 3
+// the linearization dictionary has to be in the first 1024 bytes
+#define HEADER_SIZE 1024
+
+
 Download::Download() :
 	manager(new QNetworkAccessManager()),
-	file(NULL) {
+	file(NULL),
+	cached(false),
+	from_cache(false),
+	reply(NULL),
+	loop(NULL) {
 }
 
 Download::~Download() {
+	if (reply != NULL) {
+		reply->abort();
+		delete reply;
+	}
 	delete manager;
 	delete file;
 }
 
 QString Download::load(QString f) {
-	QUrl url(f);
+	url = QUrl(f);
 	if (url.isLocalFile() || url.isRelative()) {
 		// found local file, do not download
 		return QDir::toNativeSeparators(url.toLocalFile());
 	}
 
-	QEventLoop loop;
-	QObject::connect(manager, SIGNAL(finished(QNetworkReply *)), &loop, SLOT(quit()));
-	QNetworkReply *reply = manager->get(QNetworkRequest(url));
-	QObject::connect(reply, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(progress(qint64, qint64)));
-	loop.exec();
-#ifdef DEBUG
-	cerr << "File downloaded" << endl;
-#endif
-
-	// find unique temporary filename
 	QFileInfo fileInfo(url.path());
 	QString fileName = fileInfo.fileName();
 	delete file;
-	file = new QTemporaryFile(QDir::tempPath() + QDir::separator() + fileName);
+	file = NULL;
+	cache_file.clear();
+	cache_meta.clear();
+	cached = false;
+	from_cache = false;
+	QString tmp_name = QDir::tempPath() + QDir::separator() + fileName;
+	if (CFG::get_instance()->get_value("Settings/download_cache").toBool()) {
+		// one directory per url, keeps the file name for the window title
+		QString hash = QString::fromLatin1(QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1).toHex());
+		QString dir = get_cache_dir(QString::fromUtf8("downloads/") + hash);
+		if (!dir.isEmpty()) {
+			if (fileName.isEmpty()) {
+				fileName = QString::fromUtf8("document.pdf");
+			}
+			cache_file = dir + QDir::separator() + fileName;
+			cache_meta = dir + QString::fromUtf8("/.meta");
+			// the validators are only written for complete files
+			cached = QFileInfo(cache_file).exists() && QFileInfo(cache_meta).exists();
+			// same file system, so it can be renamed over the cached file
+			tmp_name = cache_file + QString::fromUtf8(".XXXXXX");
+		}
+	}
+	// find unique temporary filename; the cached file stays untouched until
+	// the download is complete, another instance may be showing it
+	file = new QTemporaryFile(tmp_name);
 	file->setAutoRemove(true);
-	file->open();
-
-	if (reply->error() != QNetworkReply::NoError || !reply->isReadable()) {
-		cerr << reply->errorString().toStdString() << endl;
+	if (!file->open()) {
+		cerr << file->errorString().toStdString() << endl;
 		return QString();
 	}
 
-	// store data in tempfile
-	QByteArray data = reply->readAll();
-	reply->deleteLater();
-	file->write(data);
-	file->close();
+	header.clear();
+	received = 0;
+	first_page_end = -1;
+	retries = 0;
+	displayable = false;
+	done = false;
+	failed = false;
+	start_request();
+
+	// the data is written to the file while it arrives
+	QEventLoop event_loop;
+	loop = &event_loop;
+	event_loop.exec();
+	loop = NULL;
+
+	if (failed) {
+		return QString();
+	}
+	if (from_cache) {
+		return cache_file;
+	}
 #ifdef DEBUG
 	cerr << "filename: " << file->fileName().toStdString() << endl;
 #endif
 	return file->fileName();
 }
 
+void Download::start_request() {
+	QNetworkRequest request(url);
+	if (received > 0) {
+		// resume an interrupted download
+		request.setRawHeader("Range", "bytes=" + QByteArray::number(received) + "-");
+	} else if (cached) {
+		// only download if it changed
+		QSettings meta(cache_meta, QSettings::IniFormat);
+		QByteArray etag = meta.value(QString::fromUtf8("etag")).toString().toLatin1();
+		QByteArray last_modified = meta.value(QString::fromUtf8("last_modified")).toString().toLatin1();
+		if (!etag.isEmpty()) {
+			request.setRawHeader("If-None-Match", etag);
+		}
+		if (!last_modified.isEmpty()) {
+			request.setRawHeader("If-Modified-Since", last_modified);
+		}
+	}
+	request_offset = received;
+	reply = manager->get(request);
+	connect(reply, SIGNAL(readyRead()), this, SLOT(read_data()));
+	connect(reply, SIGNAL(finished()), this, SLOT(finished()));
+	connect(reply, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(progress(qint64, qint64)));
+}
+
+void Download::read_data() {
+	int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	if (reply->error() != QNetworkReply::NoError || status >= 400 || status == 304) {
+		// don't store error pages
+		return;
+	}
+	if (request_offset > 0 && received == request_offset && status != 206) {
+		// the server ignored the range, start over
+		file->resize(0);
+		file->seek(0);
+		header.clear();
+		received = 0;
+		request_offset = 0;
+	}
+
+	QByteArray data = reply->readAll();
+	if (file->write(data) != data.size()) {
+		cerr << file->errorString().toStdString() << endl;
+	}
+	// make it visible to poppler
+	file->flush();
+	received += data.size();
+
+	if (first_page_end == -1) {
+		header.append(data.left(HEADER_SIZE - header.size()));
+		if (header.size() >= HEADER_SIZE) {
+			first_page_end = parse_linearization();
+		}
+	}
+	if (!displayable && first_page_end > 0 && received >= first_page_end) {
+		// poppler may be able to show the first page, the rest keeps arriving
+		displayable = true;
+#ifdef DEBUG
+		cerr << "first page downloaded" << endl;
+#endif
+		loop->quit();
+	}
+}
+
+void Download::finished() {
+	QNetworkReply *r = reply;
+	reply = NULL;
+	r->deleteLater();
+
+	if (r->error() != QNetworkReply::NoError) {
+		cerr << r->errorString().toStdString() << endl;
+		bool resumable = r->rawHeader("Accept-Ranges") == "bytes" || r->hasRawHeader("Content-Range");
+		if (resumable && received > 0 && retries < MAX_RETRIES) {
+			retries++;
+			cerr << "resuming download at " << received << " bytes" << endl;
+			start_request();
+			return;
+		}
+		failed = !displayable;
+		if (failed && cached && received == 0) {
+			// e.g. offline, the old version is better than nothing
+			cerr << "using cached " << cache_file.toStdString() << endl;
+			failed = false;
+			from_cache = true;
+		} else if (displayable) {
+			// load() already returned, tell the viewer
+			emit aborted(r->errorString());
+		}
+	} else if (r->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304) {
+		done = true;
+		from_cache = true;
+		cerr << "using cached " << cache_file.toStdString() << endl;
+	} else {
+		done = true;
+		file->flush();
+		if (!cache_file.isEmpty()) {
+			// if this fails, the download is still shown from the temporary file
+			from_cache = replace_cache_file(r);
+		}
+#ifdef DEBUG
+		cerr << "File downloaded" << endl;
+#endif
+	}
+
+	if (!displayable) {
+		loop->quit();
+	} else if (done) {
+		// the viewer already shows the incomplete file
+		emit completed(from_cache ? cache_file : file->fileName());
+	}
+}
+
+bool Download::replace_cache_file(QNetworkReply *r) {
+	// validators of the old version must not describe the new one
+	QFile::remove(cache_meta);
+	cached = false;
+	if (::rename(QFile::encodeName(file->fileName()).constData(),
+				QFile::encodeName(cache_file).constData()) != 0) {
+		cerr << "failed to move the download to " << cache_file.toStdString() << endl;
+		return false;
+	}
+	// the temporary name is gone
+	file->setAutoRemove(false);
+	write_cache_meta(r);
+	return true;
+}
+
+void Download::write_cache_meta(QNetworkReply *r) const {
+	QByteArray etag = r->rawHeader("ETag");
+	QByteArray last_modified = r->rawHeader("Last-Modified");
+	if (etag.isEmpty() && last_modified.isEmpty()) {
+		// can't revalidate, download again next time
+		return;
+	}
+	QSettings meta(cache_meta, QSettings::IniFormat);
+	meta.setValue(QString::fromUtf8("url"), QString::fromLatin1(url.toEncoded()));
+	meta.setValue(QString::fromUtf8("etag"), QString::fromLatin1(etag));
+	meta.setValue(QString::fromUtf8("last_modified"), QString::fromLatin1(last_modified));
+}
+
+qint64 Download::parse_linearization() const {
+	// e.g. << /Linearized 1 /L 54321 /H [ 680 203 ] /O 9 /E 24101 /N 3 /T 54000 >>
+	int start = header.indexOf("/Linearized");
+	if (start == -1) {
+		return 0;
+	}
+	int end = header.indexOf(">>", start);
+	if (end == -1) {
+		return 0;
+	}
+	QString dict = QString::fromLatin1(header.mid(start, end - start));
+
+	QRegExp length(QString::fromUtf8("/L\\s+(\\d+)"));
+	QRegExp first_page(QString::fromUtf8("/E\\s+(\\d+)"));
+	if (length.indexIn(dict) == -1 || first_page.indexIn(dict) == -1) {
+		return 0;
+	}
+	// an incrementally updated file is not linearized anymore
+	QVariant total = reply->header(QNetworkRequest::ContentLengthHeader);
+	if (total.isValid() && total.toLongLong() + request_offset != length.cap(1).toLongLong()) {
+		return 0;
+	}
+	return first_page.cap(1).toLongLong();
+}
+
 void Download::progress(qint64 bytes_received, qint64 bytes_total) {
 	cout.precision(1);
-	cout << fixed << (bytes_received / 1024.0f) << "/";
-	cout << (bytes_total / 1024.0f) << "KB downloaded\r";
+	cout << fixed << ((request_offset + bytes_received) / 1024.0f) << "/";
+	cout << ((request_offset + bytes_total) / 1024.0f) << "KB downloaded\r";
 }
 
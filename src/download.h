@@ -2,8 +2,13 @@
 #define DOWNLOAD_H
 
 #include <QString>
+#include <QUrl>
+#include <QByteArray>
 #include <QNetworkAccessManager>
-#include <QTemporaryFile>
+
+class QNetworkReply;
+class QEventLoop;
+class QTemporaryFile;
 
 
 class Download : public QObject {
@@ -13,14 +18,51 @@ public:
 	Download();
 	~Download();
 
+	// returns the local file once the first page of a linearized pdf has
+	// arrived, otherwise when it is complete
+	// poppler only opens the truncated file by reconstructing its broken
+	// xref table, which is not guaranteed to show anything
+	// with Settings/download_cache, an unmodified cached copy is reused
 	QString load(QString);
 
+signals:
+	// a file that was returned before it was complete is complete now,
+	// it may have moved into the cache
+	void completed(const QString &file);
+	// a file that was returned before it was complete stays incomplete
+	void aborted(const QString &error);
+
 private slots:
+	void read_data();
+	void finished();
 	void progress(qint64 bytes_received, qint64 bytes_total);
 
 private:
+	void start_request();
+	// moves the complete download over the cached copy
+	bool replace_cache_file(QNetworkReply *r);
+	void write_cache_meta(QNetworkReply *r) const;
+	// end of the first page of a linearized pdf, 0 if it isn't linearized
+	qint64 parse_linearization() const;
+
 	QNetworkAccessManager *manager;
-	QTemporaryFile *file;
+	QTemporaryFile *file; // the download, next to the cached file if there is a cache
+	QString cache_file; // empty without cache
+	QString cache_meta; // validators of the cached file
+	bool cached; // the cached file is complete
+	bool from_cache; // load() returns the cached file
+
+	QUrl url;
+	QNetworkReply *reply;
+	QEventLoop *loop; // only set while load() waits
+	QByteArray header;
+	qint64 received;
+	qint64 request_offset; // where the current (range) request starts
+	qint64 first_page_end; // -1: unknown yet
+	int retries;
+	bool displayable;
+	bool done;
+	bool failed;
 };
 
 #endif
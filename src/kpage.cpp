@@ -1,6 +1,7 @@
 #include "kpage.h"
 #include <QList>
-#include "selection.h"
+#include "textlayer.h"
+#include "linklayer.h"
 
 using namespace std;
 
@@ -11,22 +12,13 @@ KPage::KPage() :
 	for (int i = 0; i < 3; i++) {
 		status[i] = 0;
 		rotation[i] = 0;
+		draft[i] = false;
+		counted[i] = -1;
 	}
 }
 
 KPage::~KPage() {
-	if (links != NULL) {
-		Q_FOREACH(Poppler::Link *l, *links) {
-			delete l;
-		}
-	}
-	delete links;
-	if (text != NULL) {
-		Q_FOREACH(SelectionLine *line, *text) {
-			delete line;
-		}
-	}
-	delete text;
+	free_text();
 }
 
 const QImage *KPage::get_image(int index) const {
@@ -63,7 +55,14 @@ char KPage::get_rotation(int index) const {
 	return 0;
 }
 
-const QList<SelectionLine *> *KPage::get_text() const {
+const QImage *KPage::get_thumbnail() const {
+	if (thumbnail.isNull()) {
+		return NULL;
+	}
+	return &thumbnail;
+}
+
+const TextLayer *KPage::get_text() const {
 	return text;
 }
 
@@ -71,6 +70,13 @@ const QList<SelectionLine *> *KPage::get_text() const {
 //	return label;
 //}
 
+void KPage::free_text() {
+	delete links;
+	links = NULL;
+	delete text;
+	text = NULL;
+}
+
 void KPage::toggle_invert_colors() {
 	for (int i = 0; i < 3; i++) {
 		img[i].swap(img_other[i]);
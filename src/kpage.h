@@ -10,7 +10,8 @@
 #endif
 
 
-class SelectionLine;
+class TextLayer;
+class LinkLayer;
 
 
 class KPage {
@@ -22,16 +23,18 @@ public:
 	const QImage *get_image(int index = 0) const;
 	int get_width(int index = 0) const;
 	char get_rotation(int index = 0) const;
-	const QList<SelectionLine *> *get_text() const;
+	const QImage *get_thumbnail() const;
+	const TextLayer *get_text() const;
 //	QString get_label() const;
 
 private:
 	void toggle_invert_colors();
+	void free_text();
 
 	float width;
 	float height;
 	QImage img[3];
-	QImage thumbnail;
+	QImage thumbnail; // copy of its ThumbnailCache cell
 	// for inverted colors with reduced contrast
 	// img_other contain the currently not needed color versions
 	// img store the current versions to be displayed
@@ -39,12 +42,17 @@ private:
 	QImage thumbnail_other;
 
 //	QString label;
-	QList<Poppler::Link *> *links;
+	LinkLayer *links;
 	QMutex mutex;
 	int status[3];
 	char rotation[3];
+	// img[i] is a draft, e.g. a scaled copy of another image;
+	// it has the requested size but still has to be rendered properly
+	bool draft[3];
+	// frame of the last access counted in RenderStats, -1 if none
+	int counted[3];
 	bool inverted_colors; // img[]s and thumb must be consistent
-	QList<SelectionLine *> *text;
+	TextLayer *text;
 
 	friend class Worker;
 	friend class ResourceManager;
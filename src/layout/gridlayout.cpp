@@ -11,6 +11,7 @@
 #include "../search.h"
 #include "../config.h"
 #include "../kpage.h"
+#include "../trace.h"
 
 using namespace std;
 
@@ -347,6 +348,7 @@ void GridLayout::scroll_page_top_jump(int new_page, bool relative) {
 }
 
 void GridLayout::render(QPainter *painter) {
+	TRACE_SPAN("layout render", "gui");
 	// vertical
 	int cur_page = page;
 	int last_page = page + horizontal_page;
@@ -368,11 +370,25 @@ void GridLayout::render(QPainter *painter) {
 			int center_x = (grid_width - page_width) / 2;
 			int center_y = (grid_height - page_height) / 2;
 
-			const KPage *k_page = res->get_page(last_page, page_width, render_index);
+			// zoomed out far enough, the thumbnail is sufficient
+			bool use_thumbnail = res->thumbnail_fits(last_page, size);
+			const KPage *k_page;
+			if (use_thumbnail) {
+				k_page = res->get_thumbnail(last_page);
+			} else {
+				k_page = res->get_page(last_page, page_width, render_index);
+			}
 			if (k_page != NULL) {
-				const QImage *img = k_page->get_image();
+				const QImage *img;
+				int rot;
+				if (use_thumbnail) {
+					img = k_page->get_thumbnail();
+					rot = res->get_rotation(); // thumbnails are not rotated
+				} else {
+					img = k_page->get_image(render_index);
+					rot = (res->get_rotation() - k_page->get_rotation(render_index) + 4) % 4;
+				}
 				if (img != NULL) {
-					int rot = (res->get_rotation() - k_page->get_rotation() + 4) % 4;
 					QRect rect;
 					painter->rotate(rot * 90);
 					// calculate page position
@@ -391,7 +407,7 @@ void GridLayout::render(QPainter *painter) {
 								page_height, page_width);
 					}
 					// draw scaled
-					if (page_width != k_page->get_width() || rot != 0) {
+					if (use_thumbnail || page_width != k_page->get_width(render_index) || rot != 0) {
 						painter->drawImage(rect, *img);
 					} else { // draw as-is
 						painter->drawImage(rect.topLeft(), *img);
@@ -420,20 +436,22 @@ void GridLayout::render(QPainter *painter) {
 	}
 
 	last_visible_page = last_page;
-	res->collect_garbage(page + horizontal_page - grid->get_offset() - prefetch_count * 3, last_page + prefetch_count * 3, render_index);
+	res->collect_garbage(page + horizontal_page - grid->get_offset() - prefetch_count * 3, last_page + prefetch_count * 3, render_index, is_active());
 
 	// prefetch
 	int prefetch_first = page + horizontal_page - grid->get_offset() - 1;
 	int prefetch_last = last_visible_page + 1;
 	for (int count = 0; count < prefetch_count; count++) {
-		// after last visible page
+		// after last visible page, thumbnails are rendered anyway
 		int page_width = res->get_page_width(prefetch_last + count) * size;
-		if (res->get_page(prefetch_last + count, page_width, render_index) != NULL) {
+		if (!res->thumbnail_fits(prefetch_last + count, size) &&
+				res->get_page(prefetch_last + count, page_width, render_index, true) != NULL) {
 			res->unlock_page(prefetch_last + count);
 		}
 		// before first visible page
 		page_width = res->get_page_width(prefetch_first + count) * size;
-		if (res->get_page(prefetch_first + count, page_width, render_index) != NULL) {
+		if (!res->thumbnail_fits(prefetch_first + count, size) &&
+				res->get_page(prefetch_first + count, page_width, render_index, true) != NULL) {
 			res->unlock_page(prefetch_first + count);
 		}
 	}
@@ -652,6 +670,15 @@ bool GridLayout::page_visible(int p) const {
 	return true;
 }
 
+QRect GridLayout::get_page_rect(int p) const {
+	if (!page_visible(p)) {
+		return QRect();
+	}
+	int page_width = res->get_page_width(p) * size;
+	int page_height = ROUND(res->get_page_height(p) * size);
+	return QRect(get_target_page_distance(p), QSize(page_width, page_height));
+}
+
 bool GridLayout::supports_smooth_scrolling() const {
 	return true;
 }
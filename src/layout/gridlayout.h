@@ -34,6 +34,7 @@ public:
 	void goto_page_at(int mx, int my);
 
 	bool page_visible(int p) const;
+	QRect get_page_rect(int p) const;
 
 	bool supports_smooth_scrolling() const;
 
@@ -5,12 +5,14 @@
 #include <QApplication>
 #include "layout.h"
 #include "../viewer.h"
+#include "../canvas.h"
 #include "../resourcemanager.h"
 #include "../grid.h"
 #include "../search.h"
 #include "../config.h"
 #include "../beamerwindow.h"
 #include "../util.h"
+#include "../linklayer.h"
 
 using namespace std;
 
@@ -20,7 +22,10 @@ Layout::Layout(Viewer *v, int render_index, int _page) :
 		viewer(v), res(v->get_res()),
 		render_index(render_index),
 		page(_page), width(0), height(0),
-		search_visible(false) {
+		search_visible(false),
+		pending_select(-1, QPointF()),
+		pending_select_mode(Selection::Start),
+		pending_link(-1, QPointF()) {
 	// load config options
 	CFG *config = CFG::get_instance();
 	{
@@ -50,6 +55,10 @@ int Layout::get_page() const {
 	return page;
 }
 
+bool Layout::is_active() const {
+	return viewer->get_canvas()->get_layout() == this;
+}
+
 void Layout::activate(const Layout *old_layout) {
 	page = old_layout->get_page();
 	width = old_layout->width;
@@ -230,33 +239,59 @@ bool Layout::get_search_visible() const {
 }
 
 void Layout::select(int px, int py, enum Selection::Mode mode) {
-	pair<int, QPointF> loc = get_location_at(px, py);
+	select(get_location_at(px, py), mode);
+}
+
+void Layout::select(pair<int, QPointF> loc, enum Selection::Mode mode) {
 	loc.second.rx() *= res->get_page_width(loc.first, false);
 	loc.second.ry() *= res->get_page_height(loc.first, false);
 
-	const QList<SelectionLine *> *text = res->get_text(loc.first);
+	const TextLayer *text = res->get_text(loc.first);
+	if (mode != Selection::End) {
+		pending_select.first = -1;
+		if (text == NULL) {
+			// start again once the text is there, see text_extracted()
+			pending_select = loc;
+			pending_select_mode = mode;
+		} else {
+			// the selection keeps using the text of its first page
+			res->pin_text(loc.first);
+		}
+	}
+	if (text == NULL) {
+		// freed or not extracted yet, available for the next mouse move
+		res->request_text(loc.first);
+	}
 	selection.set_cursor(text, loc, mode);
 	viewer->layout_updated(page, false); // TODO visible? change?
 }
 
-void Layout::copy_selection_text(QClipboard::Mode mode) const {
-	QString text;
-	if (selection.is_active()) {
-		Cursor from = selection.get_cursor(true);
-		Cursor to = selection.get_cursor(false);
-		for (int i = from.page; i <= to.page; i++) {
-			text += selection.get_selection_text(i, res->get_text(i));
+void Layout::text_extracted(int page) {
+	if (pending_select.first == page) {
+		const TextLayer *text = res->get_text(page);
+		if (text != NULL) {
+			pending_select.first = -1;
+			res->pin_text(page);
+			selection.set_cursor(text, make_pair(page, pending_select.second), pending_select_mode);
+			viewer->layout_updated(this->page, false);
 		}
 	}
-	QClipboard *clipboard = QApplication::clipboard();
-	clipboard->setText(text, mode);
+	if (pending_link.first == page && res->get_links(page) != NULL) {
+		pending_link.first = -1;
+		activate_link(page, pending_link.second.x(), pending_link.second.y());
+	}
+}
+
+void Layout::copy_selection_text(QClipboard::Mode mode) const {
+	// assembled by the copy worker, pages without text are extracted there
+	res->copy_text(selection, mode);
 }
 
 void Layout::clear_selection() {
 	selection.deactivate();
 
-	QClipboard *clipboard = QApplication::clipboard();
-	clipboard->setText(QString(), QClipboard::Selection);
+	// goes through the copy worker as well, drops a copy still in progress
+	res->copy_text(selection, QClipboard::Selection);
 }
 
 void Layout::render_search_rects(QPainter *painter, int cur_page, QPoint offset, float size) {
@@ -292,8 +327,8 @@ void Layout::render_selection(QPainter *painter, int cur_page, QPoint offset, fl
 	color.setAlpha(96);
 	painter->setBrush(color);
 
-	const QList<SelectionLine *> *text = res->get_text(cur_page);
-	if (text != NULL && text->size() != 0 && selection.is_active()) {
+	const TextLayer *text = res->get_text(cur_page);
+	if (text != NULL && text->get_line_count() != 0 && selection.is_active()) {
 		Cursor from = selection.get_cursor(true);
 		Cursor to = selection.get_cursor(false);
 		if (from.page <= cur_page && to.page >= cur_page) {
@@ -301,10 +336,10 @@ void Layout::render_selection(QPainter *painter, int cur_page, QPoint offset, fl
 				from.line = 0;
 			}
 			if (to.page > cur_page) {
-				to.line = text->size() - 1;
+				to.line = text->get_line_count() - 1;
 			}
 			for (int i = from.line; i <= to.line; i++) {
-				QRectF rect = text->at(i)->get_bbox();
+				QRectF rect = text->get_line_bbox(i);
 				if (from.page == cur_page && from.line == i) {
 					rect.setLeft(from.x);
 				}
@@ -338,37 +373,48 @@ void Layout::view_hit() {
 
 void Layout::activate_link(int page, float x, float y) {
 	// find matching box
-	const QList<Poppler::Link *> *links = res->get_links(page);
+	const LinkLayer *links = res->get_links(page);
 	if (links == NULL) {
+		// follow the link once it is extracted, see text_extracted()
+		pending_link = make_pair(page, QPointF(x, y));
+		res->request_text(page);
 		return;
 	}
-	Q_FOREACH(Poppler::Link *l, *links) {
-		QRectF r = l->linkArea();
-		if (x >= r.left() && x < r.right()) {
-			if (y < r.top() && y >= r.bottom()) {
-				switch (l->linkType()) {
-					case Poppler::Link::Goto: {
-						Poppler::LinkGoto *link = static_cast<Poppler::LinkGoto *>(l);
-						// TODO support links to other files
-						goto_link_destination(link->destination());
-						return;
-					}
-					case Poppler::Link::Browse: {
-						Poppler::LinkBrowse *link = static_cast<Poppler::LinkBrowse *>(l);
-						QDesktopServices::openUrl(QUrl(link->url()));
-						break;
-					}
-					case Poppler::Link::Execute:
-					case Poppler::Link::Action:
-					case Poppler::Link::Sound:
-					case Poppler::Link::Movie:
-					case Poppler::Link::Rendition:
-					case Poppler::Link::JavaScript:
-					case Poppler::Link::None:
-						cerr << "link type not implemented (yet?)" << endl;
-				}
-			}
+	pending_link.first = -1;
+	const Poppler::Link *l = links->find(x, y);
+	if (l == NULL) {
+		return;
+	}
+	switch (l->linkType()) {
+		case Poppler::Link::Goto: {
+			const Poppler::LinkGoto *link = static_cast<const Poppler::LinkGoto *>(l);
+			// TODO support links to other files
+			goto_link_destination(link->destination());
+			break;
+		}
+		case Poppler::Link::Browse: {
+			const Poppler::LinkBrowse *link = static_cast<const Poppler::LinkBrowse *>(l);
+			QDesktopServices::openUrl(QUrl(link->url()));
+			break;
 		}
+		case Poppler::Link::Execute:
+		case Poppler::Link::Action:
+		case Poppler::Link::Sound:
+		case Poppler::Link::Movie:
+		case Poppler::Link::Rendition:
+		case Poppler::Link::JavaScript:
+		case Poppler::Link::None:
+			cerr << "link type not implemented (yet?)" << endl;
+	}
+}
+
+bool Layout::has_link_at(int px, int py) const {
+	pair<int, QPointF> loc = get_location_at(px, py);
+	// no extraction request, hovering must stay cheap
+	const LinkLayer *links = res->get_links(loc.first);
+	if (links == NULL) {
+		return false;
 	}
+	return links->find(loc.second.x(), loc.second.y()) != NULL;
 }
 
@@ -57,14 +57,22 @@ public:
 	virtual void set_search_visible(bool visible);
 
 	void select(int px, int py, enum Selection::Mode mode);
+	// loc as returned by get_location_at()
+	void select(std::pair<int, QPointF> loc, enum Selection::Mode mode);
 	void clear_selection();
+	// retries a selection start or link click that found no text on page
+	void text_extracted(int page);
 
 	// misc getters
 	virtual int get_page() const;
 	virtual bool supports_smooth_scrolling() const;
 	virtual bool get_search_visible() const;
 	virtual bool page_visible(int p) const = 0;
+	// screen area of a visible page, empty if the page is not visible
+	virtual QRect get_page_rect(int p) const = 0;
 	virtual std::pair<int, QPointF> get_location_at(int px, int py) const = 0;
+	// link under the screen position, NULL if there is none or links are not extracted yet
+	bool has_link_at(int px, int py) const;
 	void copy_selection_text(QClipboard::Mode mode = QClipboard::Selection) const;
 
 protected:
@@ -77,6 +85,8 @@ protected:
 	void render_selection(QPainter *painter, int cur_page, QPoint offset, float size);
 	void render_blank_page_background(QPainter *painter, int x, int y, int w, int h);
 	virtual void view_hit();
+	// shown in the canvas, not in the beamer
+	bool is_active() const;
 
 	Viewer *viewer;
 	ResourceManager *res;
@@ -100,6 +110,11 @@ protected:
 	float jump_padding;
 
 	MouseSelection selection;
+
+	// waiting for the text of their page, page -1 if there is none
+	std::pair<int, QPointF> pending_select;
+	enum Selection::Mode pending_select_mode;
+	std::pair<int, QPointF> pending_link;
 };
 
 
@@ -3,15 +3,21 @@
 #include "../resourcemanager.h"
 #include "../util.h"
 #include "../kpage.h"
+#include "../trace.h"
 #include "../viewer.h"
 #include "../search.h"
 #include "../config.h"
+#include "../beamerwindow.h"
+#include <iostream>
 
 using namespace std;
 
 PresenterLayout::PresenterLayout(Viewer *v, int render_index, int page) :
-		Layout(v, render_index, page) {
-	main_ratio = CFG::get_instance()->get_value("Settings/presenter_slide_ratio").toFloat();
+		Layout(v, render_index, page),
+		preloaded(false) {
+	CFG *config = CFG::get_instance();
+	main_ratio = config->get_value("Settings/presenter_slide_ratio").toFloat();
+	preload_budget = config->get_value("Settings/presenter_preload_size").toLongLong() * 1024 * 1024;
 	rebuild();
 }
 
@@ -21,6 +27,8 @@ PresenterLayout::~PresenterLayout() {
 void PresenterLayout::rebuild(bool clamp) {
 	Layout::rebuild(clamp);
 	resize(width, height);
+	// e.g. a reloaded document, request everything again
+	preloaded = false;
 }
 
 void PresenterLayout::resize(int w, int h) {
@@ -73,16 +81,28 @@ void PresenterLayout::resize(int w, int h) {
 	}
 }
 
-int PresenterLayout::calculate_fit_width(int page) const {
-	float aspect = res->get_page_aspect(page);
-	int w, h;
+void PresenterLayout::calculate_slot_size(int slot, int &w, int &h) const {
 	if (horizontal_split) {
 		w = optimized_ratio * width;
 		h = height;
+		if (slot == 1) {
+			w = width - w - useless_gap;
+			h = height / 2;
+		}
 	} else {
 		w = width;
 		h = optimized_ratio * height;
+		if (slot == 1) {
+			w = width / 2;
+			h = height - h - useless_gap;
+		}
 	}
+}
+
+int PresenterLayout::calculate_fit_width(int page, int slot) const {
+	float aspect = res->get_page_aspect(page);
+	int w, h;
+	calculate_slot_size(slot, w, h);
 
 	if ((float) w / h > aspect) {
 		return h * aspect;
@@ -91,22 +111,24 @@ int PresenterLayout::calculate_fit_width(int page) const {
 	}
 }
 
-void PresenterLayout::render(QPainter *painter) {
-	int page_width[2], page_height[2];
-	int center_x[2] = {0, 0};
-	int center_y[2] = {0, 0};
+int PresenterLayout::calculate_beamer_width(int page) const {
+	// the beamer shows a single page fitting its window
+	const BeamerWindow *beamer = viewer->get_beamer();
+	float aspect = res->get_page_aspect(page);
+	if ((float) beamer->width() / beamer->height() > aspect) {
+		return aspect * beamer->height();
+	}
+	return beamer->width();
+}
+
+void PresenterLayout::calculate_placement(int page_width[2], int page_height[2],
+		int center_x[2], int center_y[2]) const {
+	center_x[0] = center_x[1] = 0;
+	center_y[0] = center_y[1] = 0;
 
 	int w[2], h[2];
-	if (horizontal_split) {
-		w[0] = optimized_ratio * width;
-		h[0] = height;
-		w[1] = width - w[0] - useless_gap;
-		h[1] = height / 2;
-	} else {
-		w[0] = width;
-		h[0] = optimized_ratio * height;
-		w[1] = width / 2;
-		h[1] = height - h[0] - useless_gap;
+	for (int i = 0; i < 2; i++) {
+		calculate_slot_size(i, w[i], h[i]);
 	}
 
 	for (int i = 0; i < 2; i++) {
@@ -130,6 +152,13 @@ void PresenterLayout::render(QPainter *painter) {
 		center_x[1] = width - page_width[1];
 		center_y[1] = h[0] + useless_gap;
 	}
+}
+
+void PresenterLayout::render(QPainter *painter) {
+	TRACE_SPAN("layout render", "gui");
+	int page_width[2], page_height[2];
+	int center_x[2], center_y[2];
+	calculate_placement(page_width, page_height, center_x, center_y);
 
 	for (int i = 0; i < 2; i++) {
 		int index = render_index + i;
@@ -153,7 +182,7 @@ void PresenterLayout::render(QPainter *painter) {
 					rect = QRect(-center_y[i] - page_height[i], center_x[i],
 							page_height[i], page_width[i]);
 				}
-				if (page_width[i] != k_page->get_width(i) || rot != 0) { // draw scaled
+				if (page_width[i] != k_page->get_width(index) || rot != 0) { // draw scaled
 					painter->drawImage(rect, *img);
 				} else { // draw as-is
 					painter->drawImage(rect.topLeft(), *img);
@@ -182,16 +211,87 @@ void PresenterLayout::render(QPainter *painter) {
 	// prefetch
 	for (int count = 1; count <= prefetch_count; count++) {
 		// after current page
-		if (res->get_page(page + count, calculate_fit_width(page + count), render_index) != NULL) {
+		if (res->get_page(page + count, calculate_fit_width(page + count), render_index, true) != NULL) {
 			res->unlock_page(page + count);
 		}
 		// before current page
-		if (res->get_page(page - count, calculate_fit_width(page - count), render_index) != NULL) {
+		if (res->get_page(page - count, calculate_fit_width(page - count), render_index, true) != NULL) {
 			res->unlock_page(page - count);
 		}
 	}
+	preload_deck();
 	for (int i = 0; i < 2; i++) {
-		res->collect_garbage(page - prefetch_count * 3, page + 1 + prefetch_count * 3, render_index + i);
+		res->collect_garbage(page - prefetch_count * 3, page + 1 + prefetch_count * 3, render_index + i, i == 0 && is_active());
+	}
+}
+
+void PresenterLayout::preload_deck() {
+	if (preload_budget <= 0) {
+		return;
+	}
+	const BeamerWindow *beamer = viewer->get_beamer();
+	QSize beamer_size;
+	if (beamer->isVisible() && beamer->width() > 0 && beamer->height() > 0) {
+		beamer_size = beamer->size();
+	}
+	if (preloaded && preload_size == QSize(width, height) && preload_beamer_size == beamer_size) {
+		return;
+	}
+	preloaded = true;
+	preload_size = QSize(width, height);
+	preload_beamer_size = beamer_size;
+
+	// argb32 images of all pages at all sizes
+	qint64 bytes = 0;
+	for (int p = 0; p < res->get_page_count(); p++) {
+		float aspect = res->get_page_aspect(p);
+		for (int slot = 0; slot < 2; slot++) {
+			int w = calculate_fit_width(p, slot);
+			bytes += (qint64) w * (int) (w / aspect) * 4;
+		}
+		if (beamer_size.isValid()) {
+			int w = calculate_beamer_width(p);
+			bytes += (qint64) w * (int) (w / aspect) * 4;
+		}
+	}
+	bool fits = bytes <= preload_budget;
+	if (!fits) {
+		cerr << "presenter preload needs " << bytes / 1024 / 1024
+			<< " MiB, more than presenter_preload_size" << endl;
+	}
+	res->set_pinned(render_index, fits);
+	res->set_pinned(render_index + 1, fits);
+	// the beamer's single layout renders into index 0
+	res->set_pinned(0, fits && beamer_size.isValid());
+	if (!fits) {
+		return;
+	}
+
+	// the worker renders the pages closest to the current one first, see
+	// the collect_garbage() calls in render()
+	for (int p = 0; p < res->get_page_count(); p++) {
+		for (int slot = 0; slot < 2; slot++) {
+			if (res->get_page(p, calculate_fit_width(p, slot), render_index + slot, true) != NULL) {
+				res->unlock_page(p);
+			}
+		}
+		if (beamer_size.isValid()) {
+			if (res->get_page(p, calculate_beamer_width(p), 0, true) != NULL) {
+				res->unlock_page(p);
+			}
+		}
+	}
+}
+
+void PresenterLayout::stop_preload() {
+	if (!preloaded) {
+		return;
+	}
+	preloaded = false;
+	res->set_pinned(0, false);
+	// nobody else frees these indices; the beamer's index 0 is collected as usual
+	for (int i = 0; i < 2; i++) {
+		res->release_index(render_index + i);
 	}
 }
 
@@ -288,3 +388,15 @@ bool PresenterLayout::page_visible(int p) const {
 	return p == page || p == page + 1;
 }
 
+QRect PresenterLayout::get_page_rect(int p) const {
+	if (!page_visible(p)) {
+		return QRect();
+	}
+	int page_width[2], page_height[2];
+	int center_x[2], center_y[2];
+	calculate_placement(page_width, page_height, center_x, center_y);
+
+	int i = p - page;
+	return QRect(center_x[i], center_y[i], page_width[i], page_height[i]);
+}
+
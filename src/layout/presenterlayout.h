@@ -17,13 +17,32 @@ public:
 
 	std::pair<int, QPointF> get_location_at(int pixel_x, int pixel_y) const;
 	bool page_visible(int p) const;
+	QRect get_page_rect(int p) const;
+
+	// unpins and frees the preloaded slides, when leaving the layout
+	void stop_preload();
 
 protected:
-	int calculate_fit_width(int page) const;
+	// slot 0 is the current slide, 1 the preview of the next one
+	void calculate_slot_size(int slot, int &w, int &h) const;
+	int calculate_fit_width(int page, int slot = 0) const;
+	int calculate_beamer_width(int page) const;
+	void calculate_placement(int page_width[2], int page_height[2],
+			int center_x[2], int center_y[2]) const;
+	// requests every page at the sizes of both slots and the beamer,
+	// once per size, if it fits into the budget
+	void preload_deck();
 
 	float main_ratio;
 	float optimized_ratio;
 	bool horizontal_split; // true if main slide is on the left
+
+	bool preloaded;
+	QSize preload_size;
+	QSize preload_beamer_size;
+
+	// config options
+	qint64 preload_budget;
 };
 
 #endif
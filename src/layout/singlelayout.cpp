@@ -10,6 +10,7 @@
 #include "../search.h"
 #include "../config.h"
 #include "../kpage.h"
+#include "../trace.h"
 
 using namespace std;
 
@@ -41,12 +42,13 @@ const QRect SingleLayout::calculate_placement(int page) const {
 }
 
 void SingleLayout::render(QPainter *painter) {
+	TRACE_SPAN("layout render", "gui");
 	const QRect p = calculate_placement(page);
 	const KPage *k_page = res->get_page(page, p.width(), render_index);
 	if (k_page != NULL) {
-		const QImage *img = k_page->get_image();
+		const QImage *img = k_page->get_image(render_index);
 		if (img != NULL) {
-			int rot = (res->get_rotation() - k_page->get_rotation() + 4) % 4;
+			int rot = (res->get_rotation() - k_page->get_rotation(render_index) + 4) % 4;
 			QRect rect;
 			painter->rotate(rot * 90);
 			// calculate page position
@@ -63,7 +65,7 @@ void SingleLayout::render(QPainter *painter) {
 				rect = QRect(-p.y() - p.height(), p.x(),
 						p.height(), p.width());
 			}
-			if (p.width() != k_page->get_width() || rot != 0) { // draw scaled
+			if (p.width() != k_page->get_width(render_index) || rot != 0) { // draw scaled
 				painter->drawImage(rect, *img);
 			} else { // draw as-is
 				painter->drawImage(rect.topLeft(), *img);
@@ -104,15 +106,15 @@ void SingleLayout::render(QPainter *painter) {
 	// prefetch
 	for (int count = 1; count <= prefetch_count; count++) {
 		// after current page
-		if (res->get_page(page + count, calculate_fit_width(page + count), render_index) != NULL) {
+		if (res->get_page(page + count, calculate_fit_width(page + count), render_index, true) != NULL) {
 			res->unlock_page(page + count);
 		}
 		// before current page
-		if (res->get_page(page - count, calculate_fit_width(page - count), render_index) != NULL) {
+		if (res->get_page(page - count, calculate_fit_width(page - count), render_index, true) != NULL) {
 			res->unlock_page(page - count);
 		}
 	}
-	res->collect_garbage(page - prefetch_count * 3, page + prefetch_count * 3, render_index);
+	res->collect_garbage(page - prefetch_count * 3, page + prefetch_count * 3, render_index, is_active());
 }
 
 void SingleLayout::advance_invisible_hit(bool forward) {
@@ -161,3 +163,10 @@ bool SingleLayout::page_visible(int p) const {
 	return p == page;
 }
 
+QRect SingleLayout::get_page_rect(int p) const {
+	if (!page_visible(p)) {
+		return QRect();
+	}
+	return calculate_placement(p);
+}
+
@@ -17,6 +17,7 @@ public:
 	std::pair<int, QPointF> get_location_at(int px, int py) const;
 
 	bool page_visible(int p) const;
+	QRect get_page_rect(int p) const;
 
 private:
 	int calculate_fit_width(int page) const;
@@ -0,0 +1,67 @@
+#include "linklayer.h"
+#include <algorithm>
+
+using namespace std;
+
+
+LinkLayer::LinkLayer(const QList<Poppler::Link *> &links) :
+		links(links),
+		max_height(0) {
+	areas.reserve(links.size());
+	for (int i = 0; i < links.size(); i++) {
+		// poppler's link areas are upside down
+		QRectF r = links[i]->linkArea().normalized();
+		Area a;
+		a.left = r.left();
+		a.top = r.top();
+		a.right = r.right();
+		a.bottom = r.bottom();
+		a.link = i;
+		areas.push_back(a);
+		max_height = max(max_height, a.bottom - a.top);
+	}
+	// stable, links with the same top stay in document order
+	stable_sort(areas.begin(), areas.end(), less_top);
+}
+
+LinkLayer::~LinkLayer() {
+	Q_FOREACH(Poppler::Link *l, links) {
+		delete l;
+	}
+}
+
+bool LinkLayer::less_top(const Area &a, const Area &b) {
+	return a.top < b.top;
+}
+
+int LinkLayer::get_link_count() const {
+	return links.size();
+}
+
+const Poppler::Link *LinkLayer::find(float x, float y) const {
+	// first area that can reach down to y
+	Area key;
+	key.top = y - max_height;
+	QVector<Area>::const_iterator it = lower_bound(areas.begin(), areas.end(), key, less_top);
+
+	int best = -1;
+	for (; it != areas.end() && it->top <= y; ++it) {
+		if (x >= it->left && x < it->right && y >= it->top && y < it->bottom) {
+			if (best == -1 || it->link < best) {
+				best = it->link;
+			}
+		}
+	}
+	if (best == -1) {
+		return NULL;
+	}
+	return links[best];
+}
+
+qint64 LinkLayer::get_memory_usage() const {
+	// rough estimate, poppler's link classes are opaque
+	return sizeof(LinkLayer) +
+		areas.capacity() * sizeof(Area) +
+		links.size() * 256;
+}
+
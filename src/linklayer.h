@@ -0,0 +1,46 @@
+#ifndef LINKLAYER_H
+#define LINKLAYER_H
+
+#include <QList>
+#include <QVector>
+#if QT_VERSION >= 0x050000
+#	include <poppler-qt5.h>
+#else
+#	include <poppler-qt4.h>
+#endif
+
+
+// links of a page, indexed by their area for hover and click lookups
+// areas are normalized and sorted by their top edge; a point can only be
+// inside the links whose top lies within max_height above it
+class LinkLayer {
+public:
+	// takes ownership of the links
+	LinkLayer(const QList<Poppler::Link *> &links);
+	~LinkLayer();
+
+	int get_link_count() const;
+	// the first link (in document order) containing the point, NULL if there is none
+	const Poppler::Link *find(float x, float y) const;
+
+	qint64 get_memory_usage() const;
+
+private:
+	// copies would delete the links twice
+	LinkLayer(const LinkLayer &other);
+	LinkLayer &operator=(const LinkLayer &other);
+
+	struct Area {
+		float left, top, right, bottom;
+		int link;
+	};
+
+	static bool less_top(const Area &a, const Area &b);
+
+	QList<Poppler::Link *> links;
+	QVector<Area> areas;
+	float max_height;
+};
+
+#endif
+
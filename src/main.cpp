@@ -7,6 +7,8 @@
 #include "resourcemanager.h"
 #include "viewer.h"
 #include "config.h"
+#include "trace.h"
+#include "batchrender.h"
 #include "dbus/dbus.h"
 
 using namespace std;
@@ -19,6 +21,7 @@ static void print_version() {
 static void print_help(char *name) {
 	cout << "Usage:" << endl;
 	cout << "  " << name << " ([OPTIONS] FILE|(-u URL))*" << endl;
+	cout << "  " << name << " --render [OPTIONS] FILE" << endl;
 	cout << endl;
 	cout << "Options:" << endl;
 	cout << "  -u, --url                         Open a URL instead of a local file" << endl;
@@ -27,11 +30,20 @@ static void print_help(char *name) {
 	cout << "  -q, --quit true|false             Quit on initialization failure" << endl;
 	cout << "  -s, --single-instance true|false  Whether to have a single instance per file" << endl;
 	cout << "  --write-default-config FILE       Write the default configuration to FILE and exit" << endl;
+	cout << "  --trace FILE                      Record a Chrome trace and write it to FILE on exit" << endl;
 	cout << "  -v, --version                     Print version information and exit" << endl;
 	cout << "  -h, --help                        Print this help and exit" << endl;
+	cout << endl;
+	cout << "Use '" << name << " --render --help' for the options of the render mode." << endl;
 }
 
 int main(int argc, char *argv[]) {
+	// render to files, must not create a QApplication
+	if (argc > 1 && !strcmp(argv[1], "--render")) {
+		argv[1] = argv[0];
+		return batch_render(argc - 1, argv + 1);
+	}
+
 	QApplication app(argc, argv);
 
 	// parse command line options
@@ -42,6 +54,7 @@ int main(int argc, char *argv[]) {
 		{"quit",					required_argument,	NULL,	'q'},
 		{"single-instance",			required_argument,	NULL,	's'},
 		{"write-default-config",	required_argument,	NULL,	0},
+		{"trace",					required_argument,	NULL,	0},
 		{"help",					no_argument,		NULL,	'h'},
 		{"version",					no_argument,		NULL,	'v'},
 		{NULL, 0, NULL, 0}
@@ -59,6 +72,8 @@ int main(int argc, char *argv[]) {
 				if (!strcmp(option_name, "write-default-config")) {
 					CFG::write_defaults(optarg);
 					return 0;
+				} else if (!strcmp(option_name, "trace")) {
+					Trace::get_instance()->start(QString::fromLocal8Bit(optarg));
 				}
 				break;
 			}
@@ -138,10 +153,15 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 	katarakt.show();
+	// linearized downloads are shown before they are complete
+	QObject::connect(&download, SIGNAL(completed(const QString &)), &katarakt, SLOT(open(QString)));
+	QObject::connect(&download, SIGNAL(aborted(const QString &)), &katarakt, SLOT(show_download_error(const QString &)));
 
 	// initialize dbus interfaces
 	dbus_init(&katarakt);
 
-	return app.exec();
+	int ret = app.exec();
+	Trace::get_instance()->write();
+	return ret;
 }
 
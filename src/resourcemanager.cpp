@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <QSocketNotifier>
 #include <QFileInfo>
+#include <QApplication>
 #ifdef __linux__
 #include <sys/inotify.h>
 #endif
@@ -12,9 +13,15 @@
 #include "util.h"
 #include "kpage.h"
 #include "worker.h"
+#include "copyworker.h"
 #include "viewer.h"
 #include "beamerwindow.h"
-#include "selection.h"
+#include "textlayer.h"
+#include "linklayer.h"
+#include "thumbnailcache.h"
+#include "config.h"
+#include "stats.h"
+#include "trace.h"
 #include "layout/layout.h"
 
 using namespace std;
@@ -23,8 +30,10 @@ using namespace std;
 Request::Request(int width, int index) {
 	for (int i = 0; i < 3; i++) {
 		this->width[i] = -1;
+		queued[i] = 0;
 	}
 	this->width[index] = width;
+	queued[index] = RenderStats::now();
 }
 
 int Request::get_lowest_index() {
@@ -52,6 +61,9 @@ bool Request::remove_index_ok(int index) {
 }
 
 void Request::update(int width, int index) {
+	if (this->width[index] == -1) {
+		queued[index] = RenderStats::now();
+	}
 	this->width[index] = width;
 }
 
@@ -61,6 +73,8 @@ ResourceManager::ResourceManager(const QString &file, Viewer *v) :
 		file(file),
 		doc(NULL),
 		center_page(0),
+		motion(0),
+		frame(0),
 		rotation(0),
 #ifdef __linux__
 		i_notifier(NULL),
@@ -73,6 +87,14 @@ ResourceManager::ResourceManager(const QString &file, Viewer *v) :
 void ResourceManager::initialize(const QString &file, const QByteArray &password) {
 	page_count = 0;
 	k_page = NULL;
+	thumbnails = NULL;
+	text_pages.clear();
+	text_bytes = 0;
+	text_budget = CFG::get_instance()->get_value("Settings/text_cache_size").toLongLong() * 1024 * 1024;
+	text_pin = -1;
+	for (int i = 0; i < 3; i++) {
+		pinned[i] = false;
+	}
 
 	doc = NULL;
 	if (!file.isNull()) {
@@ -84,8 +106,12 @@ void ResourceManager::initialize(const QString &file, const QByteArray &password
 		// on first start the canvas has not yet been constructed
 		connect(worker, SIGNAL(page_rendered(int)), viewer->get_canvas(), SLOT(page_rendered(int)), Qt::UniqueConnection);
 		connect(worker, SIGNAL(page_rendered(int)), viewer->get_beamer(), SLOT(page_rendered(int)), Qt::UniqueConnection);
+		connect(worker, SIGNAL(text_extracted(int)), viewer->get_canvas(), SLOT(text_extracted(int)), Qt::UniqueConnection);
+		connect(worker, SIGNAL(text_extracted(int)), viewer->get_beamer(), SLOT(text_extracted(int)), Qt::UniqueConnection);
 	}
-	worker->start();
+	copy_worker = new CopyWorker(file, password);
+	connect(copy_worker, SIGNAL(text_copied(const QString &, int)), this, SLOT(set_clipboard_text(const QString &, int)), Qt::UniqueConnection);
+	copy_worker->start();
 
 	// setup inotify
 #ifdef __linux__
@@ -115,18 +141,7 @@ void ResourceManager::initialize(const QString &file, const QByteArray &password
 //		cerr << "missing password" << endl;
 		return;
 	}
-	doc->setRenderHint(Poppler::Document::Antialiasing, true);
-	doc->setRenderHint(Poppler::Document::TextAntialiasing, true);
-	doc->setRenderHint(Poppler::Document::TextHinting, true);
-#if POPPLER_VERSION >= POPPLER_VERSION_CHECK(0, 18, 0)
-	doc->setRenderHint(Poppler::Document::TextSlightHinting, true);
-#endif
-#if POPPLER_VERSION >= POPPLER_VERSION_CHECK(0, 22, 0)
-//	doc->setRenderHint(Poppler::Document::OverprintPreview, true); // TODO what is this?
-#endif
-#if POPPLER_VERSION >= POPPLER_VERSION_CHECK(0, 24, 0)
-	doc->setRenderHint(Poppler::Document::ThinLineSolid, true); // TODO what's the difference between ThinLineSolid and ThinLineShape?
-#endif
+	set_render_hints(doc);
 
 	page_count = doc->numPages();
 
@@ -134,14 +149,17 @@ void ResourceManager::initialize(const QString &file, const QByteArray &password
 	max_aspect = numeric_limits<float>::min();
 
 	k_page = new KPage[get_page_count()];
+	QList<QSizeF> page_sizes;
 	for (int i = 0; i < get_page_count(); i++) {
 		Poppler::Page *p = doc->page(i);
 		if (p == NULL) {
 			cerr << "failed to load page " << i << endl;
+			page_sizes.push_back(QSizeF());
 			continue;
 		}
 		k_page[i].width = p->pageSizeF().width();
 		k_page[i].height = p->pageSizeF().height();
+		page_sizes.push_back(p->pageSizeF());
 
 		float aspect = k_page[i].width / k_page[i].height;
 		if (aspect < min_aspect) {
@@ -157,6 +175,34 @@ void ResourceManager::initialize(const QString &file, const QByteArray &password
 //		}
 		delete p;
 	}
+
+	int thumbnail_pixels = CFG::get_instance()->get_value("Settings/thumbnail_pixels").toInt();
+	thumbnails = new ThumbnailCache(file, page_sizes, thumbnail_pixels);
+	if (thumbnails->load()) {
+		for (int i = 0; i < get_page_count(); i++) {
+			k_page[i].thumbnail = thumbnails->get(i, false);
+			k_page[i].thumbnail_other = thumbnails->get(i, true);
+		}
+	}
+
+	// the worker renders thumbnails when idle, so it needs the pages
+	worker->start();
+}
+
+void ResourceManager::set_render_hints(Poppler::Document *doc, bool fast) {
+	// fast: cheap settings for drafts while the view is moving
+	doc->setRenderHint(Poppler::Document::Antialiasing, !fast);
+	doc->setRenderHint(Poppler::Document::TextAntialiasing, !fast);
+	doc->setRenderHint(Poppler::Document::TextHinting, !fast);
+#if POPPLER_VERSION >= POPPLER_VERSION_CHECK(0, 18, 0)
+	doc->setRenderHint(Poppler::Document::TextSlightHinting, !fast);
+#endif
+#if POPPLER_VERSION >= POPPLER_VERSION_CHECK(0, 22, 0)
+//	doc->setRenderHint(Poppler::Document::OverprintPreview, true); // TODO what is this?
+#endif
+#if POPPLER_VERSION >= POPPLER_VERSION_CHECK(0, 24, 0)
+	doc->setRenderHint(Poppler::Document::ThinLineSolid, true); // TODO what's the difference between ThinLineSolid and ThinLineShape?
+#endif
 }
 
 ResourceManager::~ResourceManager() {
@@ -167,12 +213,16 @@ void ResourceManager::shutdown() {
 	if (worker != NULL) {
 		join_threads();
 	}
+	copy_worker->join();
+	delete copy_worker;
 	garbageMutex.lock();
 	for (int i = 0; i < 3; i++) {
 		garbage[i].clear();
 	}
 	garbageMutex.unlock();
 	requests.clear();
+	stale_requests.clear();
+	text_requests.clear();
 	requestSemaphore.acquire(requestSemaphore.available());
 #ifdef __linux__
 	::close(inotify_fd);
@@ -180,11 +230,15 @@ void ResourceManager::shutdown() {
 	i_notifier = NULL;
 #endif
 	delete doc;
+	qDeleteAll(destinations);
+	destinations.clear();
 	delete[] k_page;
+	delete thumbnails;
 	delete worker;
 }
 
 void ResourceManager::load(const QString &file, const QByteArray &password) {
+	TRACE_SPAN("load", "resources");
 	shutdown();
 	initialize(file, password);
 }
@@ -208,28 +262,78 @@ void ResourceManager::set_file(const QString &new_file) {
 	file = new_file;
 }
 
-const KPage *ResourceManager::get_page(int page, int width, int index) {
+const KPage *ResourceManager::get_page(int page, int width, int index, bool prefetch) {
 	if (page < 0 || page >= get_page_count()) {
 		return NULL;
 	}
 
 	// page not available or wrong size/rotation/color
-	k_page[page].mutex.lock();
+	trace_lock(&k_page[page].mutex, "KPage::mutex");
 	bool must_invert_colors = k_page[page].inverted_colors != inverted_colors;
 	if (must_invert_colors) {
 		k_page[page].toggle_invert_colors();
 	}
 
-	if (k_page[page].img[index].isNull() ||
-			k_page[page].status[index] != width ||
-			k_page[page].rotation[index] != rotation ||
-			must_invert_colors) {
-		enqueue(page, width, index);
+	// drafts are good enough while the view is moving
+	bool hit = !k_page[page].img[index].isNull() &&
+		k_page[page].status[index] == width &&
+		k_page[page].rotation[index] == rotation &&
+		!must_invert_colors;
+	if (!hit || (k_page[page].draft[index] && motion.fetchAndAddRelaxed(0) == 0)) {
+		bool stale = false;
+		if (!hit) {
+			for (int i = 0; i < 3; i++) {
+				if (!k_page[page].img[i].isNull() && !k_page[page].draft[i]) {
+					stale = true;
+					break;
+				}
+			}
+		}
+		enqueue(page, width, index, stale);
+	}
+	// the layouts may ask several times while painting one frame
+	if (!prefetch && k_page[page].counted[index] != frame) {
+		k_page[page].counted[index] = frame;
+		RenderStats::get_instance()->add_cache_access(hit && !k_page[page].draft[index]);
 	}
 
 	return &k_page[page];
 }
 
+const KPage *ResourceManager::get_thumbnail(int page) {
+	if (page < 0 || page >= get_page_count()) {
+		return NULL;
+	}
+	trace_lock(&k_page[page].mutex, "KPage::mutex");
+	if (k_page[page].inverted_colors != inverted_colors) {
+		k_page[page].toggle_invert_colors();
+	}
+	return &k_page[page];
+}
+
+bool ResourceManager::is_page_ready(int page, int width, int index) const {
+	if (page < 0 || page >= get_page_count()) {
+		return false;
+	}
+	k_page[page].mutex.lock();
+	bool ready = !k_page[page].img[index].isNull() &&
+		k_page[page].status[index] == width &&
+		k_page[page].rotation[index] == rotation &&
+		!k_page[page].draft[index] &&
+		k_page[page].inverted_colors == inverted_colors;
+	k_page[page].mutex.unlock();
+	return ready;
+}
+
+bool ResourceManager::thumbnail_fits(int page, float scale) const {
+	if (page < 0 || page >= get_page_count() || thumbnails == NULL) {
+		return false;
+	}
+	QSize size = thumbnails->get_size(page);
+	return k_page[page].width * scale <= size.width() &&
+		k_page[page].height * scale <= size.height();
+}
+
 int ResourceManager::get_rotation() const {
 	return rotation;
 }
@@ -255,13 +359,64 @@ bool ResourceManager::are_colors_inverted() const {
 	return inverted_colors;
 }
 
-void ResourceManager::collect_garbage(int keep_min, int keep_max, int index) {
-	requestMutex.lock();
-	if (index == 0) { // make a separate center_page for each index?
+void ResourceManager::begin_frame() {
+	frame++;
+}
+
+void ResourceManager::set_motion(bool moving) {
+	motion.fetchAndStoreOrdered(moving ? 1 : 0);
+}
+
+qint64 ResourceManager::get_memory_usage() const {
+	qint64 bytes = 0;
+	for (int page = 0; page < get_page_count(); page++) {
+		KPage &kp = k_page[page];
+		kp.mutex.lock();
+		for (int i = 0; i < 3; i++) {
+#if QT_VERSION >= 0x050a00
+			bytes += kp.img[i].sizeInBytes() + kp.img_other[i].sizeInBytes();
+#else
+			bytes += kp.img[i].byteCount() + kp.img_other[i].byteCount();
+#endif
+		}
+		kp.mutex.unlock();
+	}
+	link_mutex.lock();
+	bytes += text_bytes;
+	link_mutex.unlock();
+	return bytes;
+}
+
+void ResourceManager::collect_garbage(int keep_min, int keep_max, int index, bool center) {
+	if (center) {
+		requestMutex.lock();
 		center_page = (keep_min + keep_max) / 2;
+		requestMutex.unlock();
 	}
-	requestMutex.unlock();
-	// free distant pages
+	collect_text_garbage(keep_min, keep_max);
+	if (pinned[index]) {
+		return;
+	}
+
+	free_images(keep_min, keep_max, index);
+	// keep the request list small
+	if (keep_max >= keep_min) {
+		drop_requests(keep_min, keep_max, index);
+	}
+}
+
+void ResourceManager::set_pinned(int index, bool pin) {
+	pinned[index] = pin;
+}
+
+void ResourceManager::release_index(int index) {
+	pinned[index] = false;
+	// empty range, nothing is kept
+	free_images(0, -1, index);
+	drop_requests(0, -1, index);
+}
+
+void ResourceManager::free_images(int keep_min, int keep_max, int index) {
 	garbageMutex.lock();
 	for (set<int>::iterator it = garbage[index].begin(); it != garbage[index].end(); /* empty */) {
 		int page = *it;
@@ -278,14 +433,13 @@ void ResourceManager::collect_garbage(int keep_min, int keep_max, int index) {
 		k_page[page].img_other[index] = QImage();
 		k_page[page].status[index] = 0;
 		k_page[page].rotation[index] = 0;
+		k_page[page].draft[index] = false;
 		k_page[page].mutex.unlock();
 	}
 	garbageMutex.unlock();
+}
 
-	// keep the request list small
-	if (keep_max < keep_min) {
-		return;
-	}
+void ResourceManager::drop_requests(int keep_min, int keep_max, int index) {
 	requestMutex.lock();
 	for (map<int,Request>::iterator it = requests.begin(); it != requests.end(); ) {
 		if ((it->first < keep_min || it->first > keep_max) && it->second.has_index(index)) {
@@ -297,12 +451,66 @@ void ResourceManager::collect_garbage(int keep_min, int keep_max, int index) {
 			++it;
 		}
 	}
+	RenderStats::get_instance()->set_queue_depth(requests.size());
 	requestMutex.unlock();
 }
 
+void ResourceManager::collect_text_garbage(int keep_min, int keep_max) {
+	// only the gui thread frees text, so its pointers stay valid until it does
+	link_mutex.lock();
+	if (text_bytes <= text_budget || text_pages.empty()) {
+		link_mutex.unlock();
+		return;
+	}
+	int center = (keep_min + keep_max) / 2;
+	set<int>::iterator first = text_pages.begin();
+	set<int>::iterator last = --text_pages.end();
+	bool first_done = false, last_done = false;
+	while (text_bytes > text_budget && !(first_done && last_done)) {
+		// the most distant page is at one of the ends
+		bool use_first = last_done ||
+			(!first_done && center - *first > *last - center);
+		int page = use_first ? *first : *last;
+
+		bool keep = (page >= keep_min && page <= keep_max) || page == text_pin;
+		set<int>::iterator it = use_first ? first : last;
+		if (first == last) {
+			first_done = last_done = true;
+		} else if (use_first) {
+			++first;
+		} else {
+			--last;
+		}
+		if (keep) {
+			continue;
+		}
+#ifdef DEBUG
+		cerr << "    removing text of page " << page << endl;
+#endif
+		text_bytes -= get_text_size(page);
+		k_page[page].free_text();
+		text_pages.erase(it);
+	}
+	link_mutex.unlock();
+}
+
+qint64 ResourceManager::get_text_size(int page) const {
+	const KPage &kp = k_page[page];
+	qint64 bytes = 0;
+	if (kp.text != NULL) {
+		bytes += kp.text->get_memory_usage();
+	}
+	if (kp.links != NULL) {
+		bytes += kp.links->get_memory_usage();
+	}
+	return bytes;
+}
+
 void ResourceManager::connect_canvas() const {
 	connect(worker, SIGNAL(page_rendered(int)), viewer->get_canvas(), SLOT(page_rendered(int)), Qt::UniqueConnection);
 	connect(worker, SIGNAL(page_rendered(int)), viewer->get_beamer(), SLOT(page_rendered(int)), Qt::UniqueConnection);
+	connect(worker, SIGNAL(text_extracted(int)), viewer->get_canvas(), SLOT(text_extracted(int)), Qt::UniqueConnection);
+	connect(worker, SIGNAL(text_extracted(int)), viewer->get_beamer(), SLOT(text_extracted(int)), Qt::UniqueConnection);
 }
 
 void ResourceManager::store_jump(int page) {
@@ -350,8 +558,18 @@ int ResourceManager::jump_forward() {
 	return *cur_jump_pos;
 }
 
-Poppler::LinkDestination *ResourceManager::resolve_link_destination(const QString &name) const {
-	return doc->linkDestination(name);
+const Poppler::LinkDestination *ResourceManager::resolve_link_destination(const QString &name) {
+	if (doc == NULL) {
+		return NULL;
+	}
+	QHash<QString, Poppler::LinkDestination *>::const_iterator it = destinations.constFind(name);
+	if (it != destinations.constEnd()) {
+		return it.value();
+	}
+	// poppler looks the name up in the document's name tree every time
+	Poppler::LinkDestination *link = doc->linkDestination(name);
+	destinations.insert(name, link); // unknown names are remembered as well
+	return link;
 }
 
 void ResourceManager::inotify_slot() {
@@ -373,6 +591,7 @@ void ResourceManager::inotify_slot() {
 
 			QFileInfo info(file);
 			if (info.fileName() == QString::fromLocal8Bit(event->name)) {
+				TRACE_SPAN("inotify reload", "resources");
 				viewer->reload(false); // don't clamp
 				i_notifier->setEnabled(true);
 				return;
@@ -386,8 +605,11 @@ void ResourceManager::inotify_slot() {
 #endif
 }
 
-void ResourceManager::enqueue(int page, int width, int index) {
-	requestMutex.lock();
+void ResourceManager::enqueue(int page, int width, int index, bool stale) {
+	trace_lock(&requestMutex, "requestMutex");
+	if (stale) {
+		stale_requests[make_pair(page, index)] = width;
+	}
 	map<int,Request>::iterator it = requests.find(page);
 	if (it == requests.end()) {
 		requests.insert(make_pair(page, Request(width, index)));
@@ -395,6 +617,7 @@ void ResourceManager::enqueue(int page, int width, int index) {
 	} else {
 		it->second.update(width, index);
 	}
+	RenderStats::get_instance()->set_queue_depth(requests.size());
 	requestMutex.unlock();
 }
 
@@ -456,26 +679,71 @@ int ResourceManager::get_page_count() const {
 	return page_count;
 }
 
-const QList<Poppler::Link *> *ResourceManager::get_links(int page) {
+const LinkLayer *ResourceManager::get_links(int page) {
 	if (page < 0 || page >= get_page_count()) {
 		return NULL;
 	}
 	link_mutex.lock();
-	QList<Poppler::Link *> *l = k_page[page].links;
+	LinkLayer *l = k_page[page].links;
 	link_mutex.unlock();
 	return l;
 }
 
-const QList<SelectionLine *> *ResourceManager::get_text(int page) {
+const TextLayer *ResourceManager::get_text(int page) {
 	if (page < 0 || page >= get_page_count()) {
 		return NULL;
 	}
 	link_mutex.lock();
-	QList<SelectionLine *> *t = k_page[page].text;
+	TextLayer *t = k_page[page].text;
 	link_mutex.unlock();
 	return t;
 }
 
+void ResourceManager::request_text(int page) {
+	if (page < 0 || page >= get_page_count()) {
+		return;
+	}
+	link_mutex.lock();
+	bool missing = k_page[page].text == NULL || k_page[page].links == NULL;
+	link_mutex.unlock();
+	if (!missing) {
+		return;
+	}
+	requestMutex.lock();
+	if (text_requests.insert(page).second) {
+		requestSemaphore.release(1);
+	}
+	requestMutex.unlock();
+}
+
+void ResourceManager::pin_text(int page) {
+	link_mutex.lock();
+	text_pin = page;
+	link_mutex.unlock();
+}
+
+void ResourceManager::copy_text(const MouseSelection &selection, QClipboard::Mode mode) {
+	CopyJob job;
+	job.selection = selection;
+	job.mode = mode;
+	if (selection.is_active()) {
+		// shallow copies, the worker must not touch text the gui thread may free
+		int to = min(selection.get_cursor(false).page, get_page_count() - 1);
+		link_mutex.lock();
+		for (int page = selection.get_cursor(true).page; page <= to; page++) {
+			if (k_page[page].text != NULL) {
+				job.layers.insert(make_pair(page, *k_page[page].text));
+			}
+		}
+		link_mutex.unlock();
+	}
+	copy_worker->enqueue(job);
+}
+
+void ResourceManager::set_clipboard_text(const QString &text, int mode) {
+	QApplication::clipboard()->setText(text, (QClipboard::Mode) mode);
+}
+
 QDomDocument *ResourceManager::get_toc() const {
 	if (doc == NULL || doc->isLocked()) {
 		return NULL;
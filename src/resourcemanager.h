@@ -7,6 +7,9 @@
 #include <QThread>
 #include <QMutex>
 #include <QSemaphore>
+#include <QClipboard>
+#include <QHash>
+#include <QAtomicInt>
 #if QT_VERSION >= 0x050000
 #	include <poppler-qt5.h>
 #else
@@ -23,7 +26,11 @@ class Worker;
 class Viewer;
 class QSocketNotifier;
 class QDomDocument;
-class SelectionLine;
+class TextLayer;
+class LinkLayer;
+class ThumbnailCache;
+class CopyWorker;
+class MouseSelection;
 
 
 class Request {
@@ -36,6 +43,7 @@ public:
 	void update(int width, int index);
 
 	int width[3];
+	qint64 queued[3]; // enqueue time, see RenderStats::now()
 };
 
 
@@ -55,7 +63,14 @@ public:
 	const QString &get_file() const;
 	void set_file(const QString &new_file);
 	// page (meta)data
-	const KPage *get_page(int page, int newWidth, int index);
+	// prefetches are not counted as cache accesses
+	const KPage *get_page(int page, int newWidth, int index, bool prefetch = false);
+	// locks the page like get_page(), but never requests a render
+	const KPage *get_thumbnail(int page);
+	// get_page() would return a final image, without requesting anything
+	bool is_page_ready(int page, int width, int index) const;
+	// the thumbnail is at least as big as the page at this scale
+	bool thumbnail_fits(int page, float scale) const;
 //	QString get_page_label(int page) const;
 	float get_page_width(int page, bool rotated = true) const;
 	float get_page_height(int page, bool rotated = true) const;
@@ -63,8 +78,15 @@ public:
 	float get_min_aspect(bool rotated = true) const;
 	float get_max_aspect(bool rotated = true) const;
 	int get_page_count() const;
-	const QList<Poppler::Link *> *get_links(int page);
-	const QList<SelectionLine *> *get_text(int page);
+	// NULL if not extracted yet or evicted, see request_text()
+	const LinkLayer *get_links(int page);
+	const TextLayer *get_text(int page);
+	// extract text and links of a page without rendering it
+	void request_text(int page);
+	// keeps the text of page while it is referenced elsewhere, e.g. by a selection
+	void pin_text(int page);
+	// fills the clipboard with the selected text once it is assembled
+	void copy_text(const MouseSelection &selection, QClipboard::Mode mode);
 	QDomDocument *get_toc() const;
 
 	int get_rotation() const;
@@ -72,8 +94,21 @@ public:
 	void unlock_page(int page) const;
 	void invert_colors();
 	bool are_colors_inverted() const;
-
-	void collect_garbage(int keep_min, int keep_max, int index);
+	// render drafts while the view is moving
+	void set_motion(bool moving);
+	// called before painting, get_page() counts one access per page and frame
+	void begin_frame();
+	// bytes used by cached page images, text and links
+	qint64 get_memory_usage() const;
+
+	// center: the range is around what the canvas shows, the worker renders
+	// the requests closest to its middle first
+	void collect_garbage(int keep_min, int keep_max, int index, bool center = false);
+	// collect_garbage() keeps all images and requests of a pinned index,
+	// e.g. a preloaded slide deck
+	void set_pinned(int index, bool pin);
+	// unpins index and drops all its images and requests, leaves text alone
+	void release_index(int index);
 
 	void connect_canvas() const;
 
@@ -82,13 +117,27 @@ public:
 	int jump_back();
 	int jump_forward();
 
-	Poppler::LinkDestination *resolve_link_destination(const QString &name) const;
+	// memoized until the document is reloaded, NULL if the name is unknown
+	const Poppler::LinkDestination *resolve_link_destination(const QString &name);
+
+	static void set_render_hints(Poppler::Document *doc, bool fast = false);
 
 public slots:
 	void inotify_slot();
 
+private slots:
+	void set_clipboard_text(const QString &text, int mode);
+
 private:
-	void enqueue(int page, int width, int index = 0);
+	// stale: another image of the page can be scaled into a draft meanwhile
+	void enqueue(int page, int width, int index = 0, bool stale = false);
+	// frees text and links of the most distant pages until they fit into the budget
+	void collect_text_garbage(int keep_min, int keep_max);
+	// of index, outside [keep_min, keep_max]
+	void free_images(int keep_min, int keep_max, int index);
+	void drop_requests(int keep_min, int keep_max, int index);
+	// needs link_mutex
+	qint64 get_text_size(int page) const;
 
 	void initialize(const QString &file, const QByteArray &password);
 	void join_threads();
@@ -96,6 +145,8 @@ private:
 
 	// sadly, poppler's renderToImage only supports one thread per document
 	Worker *worker;
+	// own document, turns multi-page selections into text
+	CopyWorker *copy_worker;
 
 	Viewer *viewer;
 
@@ -105,13 +156,25 @@ private:
 	QMutex garbageMutex;
 	QSemaphore requestSemaphore;
 	int center_page;
+	QAtomicInt motion; // set by the gui thread, read by the worker
+	int frame;
 	float max_aspect;
 	float min_aspect;
 	std::map<int, Request> requests; // page, index, width
+	std::map<std::pair<int, int>, int> stale_requests; // (page, index) -> width, to prescale
 	std::set<int> garbage[3];
+	bool pinned[3];
+	std::set<int> text_requests; // pages that only need text and links
 	QMutex link_mutex;
+	// protected by link_mutex
+	std::set<int> text_pages; // pages with text or links
+	qint64 text_bytes;
+	qint64 text_budget;
+	int text_pin;
 
 	KPage *k_page;
+	ThumbnailCache *thumbnails;
+	QHash<QString, Poppler::LinkDestination *> destinations;
 
 	friend class Worker;
 
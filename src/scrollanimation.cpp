@@ -0,0 +1,177 @@
+#include "scrollanimation.h"
+#include <cmath>
+#if QT_VERSION >= 0x050000
+#	include <QGuiApplication>
+#	include <QScreen>
+#endif
+#include "canvas.h"
+#include "config.h"
+#include "layout/layout.h"
+
+using namespace std;
+
+
+ScrollAnimation::ScrollAnimation(Canvas *c) :
+		canvas(c),
+		remaining_x(0), remaining_y(0),
+		pending_x(0), pending_y(0),
+		velocity_x(0), velocity_y(0),
+		fraction_x(0), fraction_y(0),
+		drag_velocity_x(0), drag_velocity_y(0) {
+	// load config options
+	CFG *config = CFG::get_instance();
+	animation_time = config->get_value("Settings/scroll_animation_time").toInt();
+	friction = config->get_value("Settings/kinetic_friction").toFloat();
+
+	// pace frames to the display refresh
+	qreal refresh_rate = 60;
+#if QT_VERSION >= 0x050000
+	QScreen *screen = QGuiApplication::primaryScreen();
+	if (screen != NULL && screen->refreshRate() > 0) {
+		refresh_rate = screen->refreshRate();
+	}
+	timer.setTimerType(Qt::PreciseTimer);
+#endif
+	timer.setInterval(qRound(1000 / refresh_rate));
+	connect(&timer, SIGNAL(timeout()), this, SLOT(frame()), Qt::UniqueConnection);
+}
+
+void ScrollAnimation::scroll_smooth(int dx, int dy) {
+	remaining_x += dx;
+	remaining_y += dy;
+	start();
+}
+
+void ScrollAnimation::scroll_kinetic(int dx, int dy) {
+	if (friction <= 0) {
+		scroll_smooth(dx, dy);
+		return;
+	}
+	// the velocity decays exponentially, the distance travelled is v / friction
+	velocity_x += dx * friction;
+	velocity_y += dy * friction;
+	start();
+}
+
+void ScrollAnimation::drag(int dx, int dy) {
+	// grabbing the view stops any other movement
+	remaining_x = remaining_y = 0;
+	velocity_x = velocity_y = 0;
+
+	pending_x += dx;
+	pending_y += dy;
+
+	// estimate the drag velocity for release_drag()
+	if (drag_clock.isValid()) {
+		float dt = drag_clock.restart() / 1000.0f;
+		if (dt > 0) {
+			drag_velocity_x = 0.8f * dx / dt + 0.2f * drag_velocity_x;
+			drag_velocity_y = 0.8f * dy / dt + 0.2f * drag_velocity_y;
+		}
+	} else {
+		drag_clock.start();
+	}
+	start();
+}
+
+void ScrollAnimation::release_drag() {
+	// only keep moving if the pointer was still in motion
+	if (friction > 0 && drag_clock.isValid() && drag_clock.elapsed() < 100) {
+		velocity_x = drag_velocity_x;
+		velocity_y = drag_velocity_y;
+		start();
+	}
+	end_drag();
+}
+
+void ScrollAnimation::end_drag() {
+	drag_clock.invalidate();
+	drag_velocity_x = drag_velocity_y = 0;
+}
+
+void ScrollAnimation::stop() {
+	timer.stop();
+	remaining_x = remaining_y = 0;
+	pending_x = pending_y = 0;
+	velocity_x = velocity_y = 0;
+	fraction_x = fraction_y = 0;
+}
+
+int ScrollAnimation::get_frame_interval() const {
+	return timer.interval();
+}
+
+bool ScrollAnimation::is_active() const {
+	return timer.isActive();
+}
+
+void ScrollAnimation::start() {
+	if (!timer.isActive()) {
+		clock.start();
+		timer.start();
+	}
+}
+
+void ScrollAnimation::frame() {
+	float dt = clock.restart() / 1000.0f;
+	if (dt > 0.1f) { // don't jump after a stall
+		dt = 0.1f;
+	}
+
+	float dx = pending_x + fraction_x;
+	float dy = pending_y + fraction_y;
+	pending_x = pending_y = 0;
+
+	// ease towards the target, ~95% are done after animation_time
+	float factor = 1.0f;
+	if (animation_time > 0) {
+		factor = 1.0f - exp(-dt * 3000.0f / animation_time);
+	}
+	dx += remaining_x * factor;
+	dy += remaining_y * factor;
+	remaining_x -= remaining_x * factor;
+	remaining_y -= remaining_y * factor;
+
+	// inertia, integrate the decaying velocity over dt
+	if (friction > 0) {
+		float decay = exp(-friction * dt);
+		dx += velocity_x * (1.0f - decay) / friction;
+		dy += velocity_y * (1.0f - decay) / friction;
+		velocity_x *= decay;
+		velocity_y *= decay;
+	}
+
+	bool done = fabs(remaining_x) < 0.5f && fabs(remaining_y) < 0.5f &&
+		fabs(velocity_x) < 10.0f && fabs(velocity_y) < 10.0f;
+	if (done) {
+		// land on the exact target, including the rest of the glide
+		dx += remaining_x;
+		dy += remaining_y;
+		if (friction > 0) {
+			dx += velocity_x / friction;
+			dy += velocity_y / friction;
+		}
+	}
+
+	// whole pixels only, carry the rest over to the next frame
+	int ix, iy;
+	if (done) {
+		ix = floor(dx + 0.5f);
+		iy = floor(dy + 0.5f);
+	} else {
+		ix = dx;
+		iy = dy;
+	}
+	fraction_x = dx - ix;
+	fraction_y = dy - iy;
+
+	if (ix != 0 || iy != 0) {
+		canvas->notify_motion();
+		canvas->get_layout()->scroll_smooth(ix, iy);
+	}
+
+	if (done) {
+		stop();
+	}
+}
+
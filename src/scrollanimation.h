@@ -0,0 +1,57 @@
+#ifndef SCROLLANIMATION_H
+#define SCROLLANIMATION_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+
+class Canvas;
+
+
+// collects scroll input and applies it once per frame
+class ScrollAnimation : public QObject {
+	Q_OBJECT
+
+public:
+	ScrollAnimation(Canvas *c);
+
+	// eased movement, e.g. for key presses
+	void scroll_smooth(int dx, int dy);
+	// inertial movement that travels (dx, dy) in total, e.g. for the mouse wheel
+	void scroll_kinetic(int dx, int dy);
+	// follows the mouse pointer, keeps moving after release_drag()
+	void drag(int dx, int dy);
+	void release_drag();
+	// like release_drag(), without inertia, e.g. after scrolling by selecting
+	void end_drag();
+
+	void stop();
+	bool is_active() const;
+	// milliseconds between two frames
+	int get_frame_interval() const;
+
+private slots:
+	void frame();
+
+private:
+	void start();
+
+	Canvas *canvas;
+	QTimer timer;
+	QElapsedTimer clock;
+	QElapsedTimer drag_clock;
+
+	float remaining_x, remaining_y; // eased distance
+	float pending_x, pending_y; // dragged distance
+	float velocity_x, velocity_y; // pixels per second
+	float fraction_x, fraction_y; // sub-pixel remainder
+	float drag_velocity_x, drag_velocity_y;
+
+	// config options
+	int animation_time;
+	float friction;
+};
+
+#endif
+
@@ -5,6 +5,7 @@
 #include "config.h"
 #include "util.h"
 #include "resourcemanager.h"
+#include "trace.h"
 #include "layout/layout.h"
 
 using namespace std;
@@ -19,6 +20,7 @@ SearchWorker::SearchWorker(SearchBar *_bar) :
 }
 
 void SearchWorker::run() {
+	Trace::get_instance()->set_thread_name("search worker");
 	while (1) {
 		bar->search_mutex.lock();
 		stop = false;
@@ -60,6 +62,7 @@ void SearchWorker::run() {
 		int hit_count = 0;
 		int page = start;
 		do {
+			TRACE_SPAN("search page", "search", page);
 			Poppler::Page *p = bar->doc->page(page);
 			if (p == NULL) {
 				cerr << "failed to load page " << page << endl;
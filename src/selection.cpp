@@ -1,332 +1,249 @@
 #include "selection.h"
+#include <limits>
+#include <algorithm>
 
 using namespace std;
 
 
-SelectionPart::SelectionPart(Poppler::TextBox *box) :
-		text_box(box) {
-	bbox = text_box->boundingBox();
-}
-
-SelectionPart::~SelectionPart() {
-	Poppler::TextBox *next;
-	do {
-		next = text_box->nextWord();
-		delete text_box;
-		text_box = next;
-	} while (next != NULL);
-}
-
-void SelectionPart::add_word(Poppler::TextBox *box) {
-	bbox = bbox.united(box->boundingBox());
-}
-
-Poppler::TextBox *SelectionPart::get_text() const {
-	return text_box;
-}
-
-QRectF SelectionPart::get_bbox() const {
-	return bbox;
-}
-
-bool selection_less_y(const SelectionPart *a, const SelectionPart *b) {
-	return a->get_bbox().center().y() < b->get_bbox().center().y();
-}
-
+// hit testing, boxes are sorted from left to right
+typedef float (TextLayer::*Coordinate)(int) const;
 
-SelectionLine::SelectionLine(SelectionPart *part) {
-	parts.push_back(part);
-	bbox = part->get_bbox();
-}
-
-SelectionLine::~SelectionLine() {
-	Q_FOREACH(SelectionPart *p, parts) {
-		delete p;
+// first i in [first, end) with x <= right(i), end if there is none
+static int bsearch_right(const TextLayer *layer, Coordinate right, int first, int end, float x) {
+	while (first < end) {
+		int mid = (first + end) / 2;
+		if (x <= (layer->*right)(mid)) {
+			end = mid;
+		} else {
+			first = mid + 1;
+		}
 	}
+	return first;
 }
 
-void SelectionLine::add_part(SelectionPart *part) {
-	parts.push_back(part);
-	bbox = bbox.united(part->get_bbox());
-}
-
-const QList<SelectionPart *> &SelectionLine::get_parts() const {
-	return parts;
-}
-
-QRectF SelectionLine::get_bbox() const {
-	return bbox;
-}
-
-void SelectionLine::sort() {
-	stable_sort(parts.begin(), parts.end(), selection_less_x);
-}
-
-bool selection_less_x(const SelectionPart *a, const SelectionPart *b) {
-	return a->get_bbox().center().x() < b->get_bbox().center().x();
+// last i in [first, end) with x >= left(i), first - 1 if there is none
+static int bsearch_left(const TextLayer *layer, Coordinate left, int first, int end, float x) {
+	while (first < end) {
+		int mid = (first + end) / 2;
+		if (x >= (layer->*left)(mid)) {
+			first = mid + 1;
+		} else {
+			end = mid;
+		}
+	}
+	return first - 1;
 }
 
 
 void Cursor::find_part(bool from, enum Selection::Mode mode) {
-	const QList<SelectionPart *> parts = selectionline->get_parts();
+	QRectF line_box = layer->get_line_bbox(line);
 	// select beginning/end of line when gap between lines is big enough
-	if (selectionline->get_bbox().top() - click.y() > selectionline->get_bbox().height()) {
-		set_beginning_of_line(selectionline, from);
+	if (line_box.top() - click.y() > line_box.height()) {
+		set_beginning_of_line(from);
 		return;
 	}
-	if (click.y() - selectionline->get_bbox().bottom() > selectionline->get_bbox().height()) {
-		set_end_of_line(selectionline, from);
+	if (click.y() - line_box.bottom() > line_box.height()) {
+		set_end_of_line(from);
 		return;
 	}
 
 	if (mode == Selection::StartLine) {
 		if (from) {
-			set_beginning_of_line(selectionline, from);
+			set_beginning_of_line(from);
 		} else {
-			set_end_of_line(selectionline, from);
+			set_end_of_line(from);
 		}
 		return;
 	}
 
+	int first = layer->get_first_part(line);
+	int end = layer->get_first_part(line + 1);
 	if (from) { // selection grows to the left
-		for (part = 0; part < parts.size(); part++) {
-			if (click.x() <= parts.at(part)->get_bbox().right()) {
-				break;
-			}
-		}
-		if (part >= parts.size()) {
-			part = parts.size() - 1;
+		part = bsearch_right(layer, &TextLayer::get_part_right, first, end, click.x());
+		if (part >= end) {
+			part = end - 1;
 		}
 	} else { // selection grows to the right
-		for (part = parts.size() - 1; part >= 0; part--) {
-			if (click.x() >= parts.at(part)->get_bbox().left()) {
-				break;
-			}
-		}
-		if (part < 0) {
-			part = 0;
+		part = bsearch_left(layer, &TextLayer::get_part_left, first, end, click.x());
+		if (part < first) {
+			part = first;
 		}
 	}
-	find_word(parts.at(part)->get_text(), from, mode);
+	find_word(from, mode);
 }
 
-void Cursor::find_word(const Poppler::TextBox *text_box, bool from, enum Selection::Mode mode) {
-	word = 0;
-	const Poppler::TextBox *next = text_box;
+void Cursor::find_word(bool from, enum Selection::Mode mode) {
+	int first = layer->get_first_word(part);
+	int end = layer->get_first_word(part + 1);
 	if (from) {
-		while (true) {
-			if (click.x() <= next->boundingBox().right()) {
-				break;
-			}
-
-			if (next->nextWord() == NULL) {
-				break;
-			}
-			next = next->nextWord();
-			word++;
+		word = bsearch_right(layer, &TextLayer::get_word_right, first, end, click.x());
+		if (word >= end) {
+			word = end - 1;
 		}
 	} else {
-		const Poppler::TextBox *prev = next;
-		while (next != NULL) {
-			if (click.x() < next->boundingBox().left()) {
-				if (word > 0) {
-					word--;
-					next = prev;
-				}
-				break;
-			}
-
-			if (next->nextWord() == NULL) {
-				break;
-			}
-			prev = next;
-			next = next->nextWord();
-			word++;
+		word = bsearch_left(layer, &TextLayer::get_word_left, first, end, click.x());
+		if (word < first) {
+			word = first;
 		}
 	}
 	if (mode == Selection::Start) {
-		find_character(next, from);
+		find_character(from);
 	} else if (mode == Selection::StartWord) {
 		if (from) {
-			character = 0;
+			character = layer->get_first_char(word);
 			inclusive = true;
-			x = next->charBoundingBox(0).left();
+			x = layer->get_char_left(character);
 		} else {
-			character = next->text().size() - 1;
+			character = layer->get_first_char(word + 1) - 1;
 			inclusive = true;
-			x = next->charBoundingBox(character).right();
+			x = layer->get_char_right(character);
 		}
 	}
 }
 
-void Cursor::find_character(const Poppler::TextBox *text, bool from) {
+void Cursor::find_character(bool from) {
+	int first = layer->get_first_char(word);
+	int end = layer->get_first_char(word + 1);
 	if (from) { // selection grows to the left
-		for (character = 0; character < text->text().size(); character++) {
-			if (click.x() <= text->charBoundingBox(character).right()) {
-				x = text->charBoundingBox(character).left();
-				inclusive = true;
-				break;
-			}
-		}
-		if (character >= text->text().size()) {
-			character = text->text().size() - 1;
-			x = text->charBoundingBox(character).right();
+		character = bsearch_right(layer, &TextLayer::get_char_right, first, end, click.x());
+		if (character < end) {
+			x = layer->get_char_left(character);
+			inclusive = true;
+		} else {
+			character = end - 1;
+			x = layer->get_char_right(character);
 			inclusive = false;
 		}
 	} else { // selection grows to the right
-		for (character = text->text().size() - 1; character >= 0; character--) {
-			if (click.x() >= text->charBoundingBox(character).left()) {
-				x = text->charBoundingBox(character).right();
-				inclusive = true;
-				break;
-			}
-		}
-		if (character < 0) {
-			character = 0;
-			x = text->charBoundingBox(character).left();
+		character = bsearch_left(layer, &TextLayer::get_char_left, first, end, click.x());
+		if (character >= first) {
+			x = layer->get_char_right(character);
+			inclusive = true;
+		} else {
+			character = first;
+			x = layer->get_char_left(character);
 			inclusive = false;
 		}
 	}
 }
 
-void Cursor::set_beginning_of_line(const SelectionLine *line, bool from) {
-	part = 0;
-	word = 0;
-	character = 0;
+void Cursor::set_beginning_of_line(bool from) {
+	part = layer->get_first_part(line);
+	word = layer->get_first_word(part);
+	character = layer->get_first_char(word);
 	inclusive = from;
-	x = line->get_parts().at(0)->get_text()->charBoundingBox(0).left();
+	x = layer->get_char_left(character);
 }
 
-void Cursor::set_end_of_line(const SelectionLine *line, bool from) {
-	part = line->get_parts().size() - 1;
-	Poppler::TextBox *text_box = line->get_parts().at(part)->get_text();
-	word = 0;
-	while (text_box->nextWord() != NULL) {
-		text_box = text_box->nextWord();
-		word++;
-	}
-	character = text_box->text().size() - 1;
+void Cursor::set_end_of_line(bool from) {
+	part = layer->get_first_part(line + 1) - 1;
+	word = layer->get_first_word(part + 1) - 1;
+	character = layer->get_first_char(word + 1) - 1;
 	inclusive = !from;
-	x = text_box->charBoundingBox(character).right();
+	x = layer->get_char_right(character);
 }
 
 void Cursor::increment() {
-	Poppler::TextBox *text_box = selectionline->get_parts().at(part)->get_text();
-	for (int i = 0; i < word; i++) {
-		text_box = text_box->nextWord();
-	}
-
 	if (!inclusive) {
 		inclusive = true;
-		x = text_box->charBoundingBox(character).left();
+		x = layer->get_char_left(character);
 		return;
 	}
 
 	character++;
-	if (character >= text_box->text().size()) {
-		if (text_box->nextWord() == NULL) {
+	if (character >= layer->get_first_char(word + 1)) {
+		if (word + 1 >= layer->get_first_word(part + 1)) {
 			part++;
-			if (part >= selectionline->get_parts().size()) {
+			if (part >= layer->get_first_part(line + 1)) {
 				part--;
 				character--;
 				inclusive = false;
-				x = text_box->charBoundingBox(character).right();
+				x = layer->get_char_right(character);
 				return;
 			}
-			word = 0;
-			character = 0;
-			inclusive = true;
-			x = selectionline->get_parts().at(part)->get_text()->charBoundingBox(0).left();
-			return;
 		}
-		text_box = text_box->nextWord();
+		// characters of consecutive words are consecutive
 		word++;
-		character = 0;
 		inclusive = true;
-		x = text_box->charBoundingBox(0).left();
-		return;
 	}
-	x = text_box->charBoundingBox(character).left();
+	x = layer->get_char_left(character);
 }
 
 void Cursor::decrement() {
-	Poppler::TextBox *text_box = selectionline->get_parts().at(part)->get_text();
-	Poppler::TextBox *prev = text_box;
-	for (int i = 0; i < word; i++) {
-		prev = text_box;
-		text_box = text_box->nextWord();
-	}
-
 	if (!inclusive) {
 		inclusive = true;
-		x = text_box->charBoundingBox(character).right();
+		x = layer->get_char_right(character);
 		return;
 	}
 
 	character--;
-	if (character < 0) {
-		if (word == 0) {
-			if (part == 0) {
-				character = 0;
+	if (character < layer->get_first_char(word)) {
+		if (word == layer->get_first_word(part)) {
+			if (part == layer->get_first_part(line)) {
+				character++;
 				inclusive = false;
-				x = text_box->charBoundingBox(0).left();
+				x = layer->get_char_left(character);
 				return;
 			}
 			part--;
-			text_box = selectionline->get_parts().at(part)->get_text();
-			word = 0;
-			while (text_box->nextWord() != NULL) {
-				text_box = text_box->nextWord();
-				word++;
-			}
-			character = text_box->text().size() - 1;
-			inclusive = true;
-			x = text_box->charBoundingBox(character).right();
-			return;
 		}
 		word--;
-		character = prev->text().size() - 1;
 		inclusive = true;
-		x = prev->charBoundingBox(character).right();
-		return;
 	}
-	x = text_box->charBoundingBox(character).right();
+	x = layer->get_char_right(character);
 }
 
 
+Cursor::Cursor() :
+		page(-1),
+		line(0),
+		part(0),
+		word(0),
+		character(0),
+		inclusive(false),
+		x(0),
+		layer(NULL) {
+}
+
 MouseSelection::MouseSelection() :
-		active(false) {
+		active(false),
+		started(false),
+		reversed(false),
+		mode(Selection::Start) {
 }
 
-void MouseSelection::set_cursor(const QList<SelectionLine *> *lines,
+void MouseSelection::set_cursor(const TextLayer *layer,
 		pair<int, QPointF> pos, enum Selection::Mode _mode) {
 	// first = true: first cursor that was created (beginning of selection)
 	// from = true: cursor that comes first (from the top left)
 	bool first = _mode != Selection::End;
 	if (first) {
 		mode = _mode;
-	}
-
-	if (first) {
 		active = false;
+		started = false;
 		reversed = false;
-	} else {
+	} else if (!started) {
+		return;
+	}
+
+	if (layer == NULL || layer->get_line_count() == 0) {
+		// keep the previous cursor, there is nothing to select on this page
+		return;
+	}
+	if (!first) {
 		active = true;
 	}
 
 	Cursor &c = cursor[first ? 0 : 1];
 	c.page = pos.first;
 	c.click = pos.second;
+	c.layer = layer;
 
-	if (lines == NULL || lines->empty()) {
-		return;
-	}
-
-	c.line = bsearch(lines, c.click.y());
-	if (c.line < lines->size() - 1) {
+	c.line = find_line(layer, c.click);
+	if (c.line < layer->get_line_count() - 1 && layer->get_line_block(c.line + 1) == layer->get_line_block(c.line)) {
 		// the click lies between line and line + 1
-		float prev = lines->at(c.line)->get_bbox().center().y();
-		float next = lines->at(c.line + 1)->get_bbox().center().y();
+		float prev = layer->get_line_bbox(c.line).center().y();
+		float next = layer->get_line_bbox(c.line + 1).center().y();
 
 		if (first) {
 			// beginning of selection -> set to closest line
@@ -341,41 +258,45 @@ void MouseSelection::set_cursor(const QList<SelectionLine *> *lines,
 			bool line_added = false;
 			if (c.click.y() - prev > next - c.click.y()) {
 				if (c.line + 1 == cursor[0].line ||
-						lines->at(c.line)->get_bbox().bottom() > lines->at(c.line + 1)->get_bbox().top()) {
+						layer->get_line_bbox(c.line).bottom() > layer->get_line_bbox(c.line + 1).top()) {
 					c.line++;
 					line_added = true;
 				}
 			}
-			update_reversed(c, lines->at(c.line));
+			update_reversed(c);
 
 			// inside actual box?
 			if (!line_added) {
-				if (lines->at(c.line)->get_bbox().bottom() <= lines->at(c.line + 1)->get_bbox().top()) {
+				if (layer->get_line_bbox(c.line).bottom() <= layer->get_line_bbox(c.line + 1).top()) {
 					if (reversed && c.line < cursor[0].line) {
-						if (c.click.y() > lines->at(c.line)->get_bbox().bottom()) {
+						if (c.click.y() > layer->get_line_bbox(c.line).bottom()) {
 							c.line++;
 						}
 					} else {
-						if (c.click.y() >= lines->at(c.line + 1)->get_bbox().top()) {
+						if (c.click.y() >= layer->get_line_bbox(c.line + 1).top()) {
 							c.line++;
 						}
 					}
 				}
 			}
 
-			update_reversed(c, lines->at(c.line));
+			update_reversed(c);
 		}
 	} else {
-		// last line
+		// last line of the block
 		if (!first) {
-			update_reversed(c, lines->at(c.line));
+			update_reversed(c);
 		}
 	}
 
 	// find closest part/word/character
-	c.selectionline = lines->at(c.line);
 	c.find_part(first ^ reversed, mode);
 
+	if (first) {
+		started = true;
+		cursor[1] = c;
+	}
+
 	// word or line selection -> set second cursor right away
 	if (first && (mode == Selection::StartWord || mode == Selection::StartLine)) {
 		cursor[1] = c;
@@ -392,88 +313,63 @@ Cursor MouseSelection::get_cursor(bool from) const {
 	}
 }
 
-QString MouseSelection::get_selection_text(int page, const QList<SelectionLine *> *lines) const {
-	QString text;
-	if (lines != NULL && lines->size() != 0 && is_active()) {
+void MouseSelection::append_selection_text(QString &text, int page, const TextLayer *layer) const {
+	if (layer != NULL && layer->get_line_count() != 0 && is_active()) {
 		Cursor from = get_cursor(true);
 		Cursor to = get_cursor(false);
 		if (from.page <= page && to.page >= page) {
 			if (from.page < page) {
+				from.layer = layer;
 				from.line = 0;
-				from.set_beginning_of_line(lines->at(from.line), true);
+				from.set_beginning_of_line(true);
 			}
 			if (to.page > page) {
-				to.line = lines->size() - 1;
-				to.set_end_of_line(lines->at(to.line), false);
+				to.layer = layer;
+				to.line = layer->get_line_count() - 1;
+				to.set_end_of_line(false);
 			}
+			// selected characters
+			int first_char = from.character + (from.inclusive ? 0 : 1);
+			int end_char = to.character + (to.inclusive ? 1 : 0);
 
 			bool add_space = false;
 
 			for (int line = from.line; line <= to.line; line++) {
-				float last_x = 0;
-				int last_x_index = -2;
-				const QList<SelectionPart *> p = lines->at(line)->get_parts();
-
-				for (int part = from.part; part < p.size(); part++) {
-					if (to.line == line && to.part < part) {
-						break;
-					}
-					int word = 0;
-					Poppler::TextBox *box = p.at(part)->get_text();
-					while (box != NULL) {
-						if (to.line == line && to.part == part && to.word < word) {
-							break;
-						}
-
-						if ((from.part == part && word >= from.word) || part > from.part) {
-							QString tmp = box->text();
-							if (to.line == line && to.part == part && to.word == word) {
-								tmp.truncate(to.character + 1);
-								if (!to.inclusive) {
-									tmp.chop(1);
-								}
-							}
-							if (from.line == line && from.part == part && from.word == word) {
-								tmp.remove(0, from.character);
-								if (!from.inclusive) {
-									tmp.remove(0, 1);
-								}
-							}
+				int first_part = line == from.line ? from.part : layer->get_first_part(line);
+				int end_part = line == to.line ? to.part + 1 : layer->get_first_part(line + 1);
 
-							if (add_space) {
-								text += QChar::fromLatin1(' ');
-								add_space = false;
-							}
-							// big gap in front of current box, add <tab>
-							if (word == 0 && part == last_x_index + 1) {
-								if (box->boundingBox().left() - last_x > box->boundingBox().height()) {
-									text += QChar::fromLatin1('\t');
-								}
-							}
+				for (int part = first_part; part < end_part; part++) {
+					int first_word = part == from.part ? from.word : layer->get_first_word(part);
+					int end_word = part == to.part ? to.word + 1 : layer->get_first_word(part + 1);
 
-							text += tmp;
-							if (box->hasSpaceAfter()) {
-								add_space = true;
+					for (int word = first_word; word < end_word; word++) {
+						if (add_space) {
+							text += QChar::fromLatin1(' ');
+							add_space = false;
+						}
+						// big gap in front of current box, add <tab>
+						if (word == layer->get_first_word(part) && part > first_part) {
+							QRectF box = layer->get_word_bbox(word);
+							if (box.left() - layer->get_word_bbox(word - 1).right() > box.height()) {
+								text += QChar::fromLatin1('\t');
 							}
 						}
 
-						last_x = box->boundingBox().right();
-						last_x_index = part;
-						box = box->nextWord();
-						word++;
+						layer->append_text(text,
+								max(first_char, layer->get_first_char(word)),
+								min(end_char, layer->get_first_char(word + 1)));
+						if (layer->has_space_after(word)) {
+							add_space = true;
+						}
 					}
 				}
 
-				if (line + 1 < lines->size()) {
-					from.set_beginning_of_line(lines->at(line + 1), true);
-					if (line < to.line) {
-						text += QChar::fromLatin1('\n');
-					}
+				if (line < to.line) {
+					text += QChar::fromLatin1('\n');
 				}
 			}
 		}
 	}
-	return text;
 }
 
 void MouseSelection::deactivate() {
@@ -484,23 +380,40 @@ bool MouseSelection::is_active() const {
 	return active;
 }
 
-int MouseSelection::bsearch(const QList<SelectionLine *> *lines, float value) {
-	int from = 0, to = lines->size();
+int MouseSelection::find_line(const TextLayer *layer, QPointF point) const {
+	// closest block
+	int best = 0;
+	float best_distance = numeric_limits<float>::max();
+	for (int block = 0; block < layer->get_block_count(); block++) {
+		QRectF bbox = layer->get_block_bbox(block);
+		float dx = qMax<qreal>(0, qMax(bbox.left() - point.x(), point.x() - bbox.right()));
+		float dy = qMax<qreal>(0, qMax(bbox.top() - point.y(), point.y() - bbox.bottom()));
+		float distance = dx * dx + dy * dy;
+		if (distance < best_distance) {
+			best_distance = distance;
+			best = block;
+		}
+	}
+	// lines are sorted by y within a block
+	return bsearch(layer, layer->get_first_line(best), layer->get_first_line(best + 1), point.y());
+}
+
+int MouseSelection::bsearch(const TextLayer *layer, int from, int to, float value) const {
 	int mid;
 
-	if (to == 0) {
-		return 0;
+	if (to == from) {
+		return from;
 	}
 
-	if (value <= lines->at(0)->get_bbox().center().y()) {
-		return 0;
-	} else if (value > lines->at(to - 1)->get_bbox().center().y()) {
+	if (value <= layer->get_line_bbox(from).center().y()) {
+		return from;
+	} else if (value > layer->get_line_bbox(to - 1).center().y()) {
 		return to - 1;
 	}
 
 	while (to - from > 1) {
 		mid = (from + to) / 2;
-		float cur = lines->at(mid)->get_bbox().center().y();
+		float cur = layer->get_line_bbox(mid).center().y();
 		if (cur == value) {
 			return mid;
 		} else if (cur < value) {
@@ -513,8 +426,8 @@ int MouseSelection::bsearch(const QList<SelectionLine *> *lines, float value) {
 	return from;
 }
 
-void MouseSelection::update_reversed(Cursor &c, const SelectionLine *line) {
-	if (reversed != calculate_reversed(c, line)) {
+void MouseSelection::update_reversed(Cursor &c) {
+	if (reversed != calculate_reversed(c)) {
 		// flip reversed flag, adjust first cursor's character
 		if (reversed) {
 			cursor[0].increment();
@@ -525,7 +438,7 @@ void MouseSelection::update_reversed(Cursor &c, const SelectionLine *line) {
 	}
 }
 
-bool MouseSelection::calculate_reversed(Cursor &c, const SelectionLine *line) const {
+bool MouseSelection::calculate_reversed(Cursor &c) const {
 	if (c.page < cursor[0].page) {
 		return true;
 	} else if (c.page > cursor[0].page) {
@@ -538,10 +451,11 @@ bool MouseSelection::calculate_reversed(Cursor &c, const SelectionLine *line) co
 		return false;
 	}
 	// same line
-	if (line->get_bbox().top() - c.click.y() > line->get_bbox().height()) {
+	QRectF line_box = c.layer->get_line_bbox(c.line);
+	if (line_box.top() - c.click.y() > line_box.height()) {
 		return true;
 	}
-	if (c.click.y() - line->get_bbox().bottom() > line->get_bbox().height()) {
+	if (c.click.y() - line_box.bottom() > line_box.height()) {
 		return false;
 	}
 	if (c.click.x() < cursor[0].x) {
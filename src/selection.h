@@ -2,11 +2,7 @@
 #define SELECTIONPART_H
 
 #include <QRectF>
-#if QT_VERSION >= 0x050000
-#	include <poppler-qt5.h>
-#else
-#	include <poppler-qt4.h>
-#endif
+#include "textlayer.h"
 
 
 namespace Selection {
@@ -19,44 +15,11 @@ namespace Selection {
 }
 
 
-class SelectionPart {
-public:
-	SelectionPart(Poppler::TextBox *box);
-	~SelectionPart();
-
-	void add_word(Poppler::TextBox *box);
-	Poppler::TextBox *get_text() const;
-	QRectF get_bbox() const;
-
-private:
-	Poppler::TextBox *text_box;
-	QRectF bbox;
-};
-
-bool selection_less_y(const SelectionPart *a, const SelectionPart *b);
-
-
-class SelectionLine {
-public:
-	SelectionLine(SelectionPart *part);
-	~SelectionLine();
-
-	void add_part(SelectionPart *part);
-	const QList<SelectionPart *> &get_parts() const;
-	QRectF get_bbox() const;
-
-	void sort();
-
-private:
-	QList<SelectionPart *> parts;
-	QRectF bbox;
-};
-
-bool selection_less_x(const SelectionPart *a, const SelectionPart *b);
-
-
+// part, word and character are indices into the whole TextLayer
 class Cursor {
 public:
+	Cursor();
+
 	int page;
 	QPointF click;
 	int line;
@@ -65,15 +28,15 @@ public:
 	int character;
 	bool inclusive;
 	float x;
-	SelectionLine *selectionline;
+	const TextLayer *layer; // NULL until the cursor was placed on text
 
 private:
 	void find_part(bool from, enum Selection::Mode mode);
-	void find_word(const Poppler::TextBox *text_box, bool from, enum Selection::Mode mode);
-	void find_character(const Poppler::TextBox *text, bool from);
+	void find_word(bool from, enum Selection::Mode mode);
+	void find_character(bool from);
 
-	void set_beginning_of_line(const SelectionLine *line, bool from);
-	void set_end_of_line(const SelectionLine *line, bool from);
+	void set_beginning_of_line(bool from);
+	void set_end_of_line(bool from);
 
 	void increment();
 	void decrement();
@@ -86,21 +49,27 @@ class MouseSelection {
 public:
 	MouseSelection();
 
-	void set_cursor(const QList<SelectionLine *> *lines, std::pair<int, QPointF> pos, enum Selection::Mode mode);
+	// a start without text (layer NULL) is not placed, the following ends
+	// are ignored until a start succeeds
+	void set_cursor(const TextLayer *layer, std::pair<int, QPointF> pos, enum Selection::Mode mode);
 	Cursor get_cursor(bool from) const;
-	QString get_selection_text(int page, const QList<SelectionLine *> *lines) const;
+	// appends the selected text of page
+	void append_selection_text(QString &text, int page, const TextLayer *layer) const;
 
 	void deactivate();
 	bool is_active() const;
 
 private:
-	int bsearch(const QList<SelectionLine *> *lines, float value);
-	void update_reversed(Cursor &c, const SelectionLine *line) ;
-	bool calculate_reversed(Cursor &c, const SelectionLine *line) const;
+	// closest line in the block closest to point
+	int find_line(const TextLayer *layer, QPointF point) const;
+	int bsearch(const TextLayer *layer, int from, int to, float value) const;
+	void update_reversed(Cursor &c);
+	bool calculate_reversed(Cursor &c) const;
 
 	Cursor cursor[2];
 
 	bool active;
+	bool started; // cursor[0] is valid
 	bool reversed;
 	enum Selection::Mode mode;
 };
@@ -0,0 +1,132 @@
+#include <QStringList>
+#include "stats.h"
+
+using namespace std;
+
+
+static const char *stage_names[RenderStats::StageCount] = {
+	"queue_wait",
+	"render",
+	"invert",
+	"thumbnail",
+	"text_extraction",
+	"publish"
+};
+
+
+RenderStats::RenderStats() :
+		cache_hits(0),
+		cache_misses(0) {
+	clock.start();
+	reset();
+}
+
+RenderStats *RenderStats::get_instance() {
+	static RenderStats instance;
+	return &instance;
+}
+
+qint64 RenderStats::now() {
+	return get_instance()->clock.nsecsElapsed();
+}
+
+void RenderStats::add_timing(enum Stage stage, qint64 nsecs) {
+	mutex.lock();
+	timing[stage].count++;
+	timing[stage].total += nsecs;
+	if (nsecs > timing[stage].max) {
+		timing[stage].max = nsecs;
+	}
+	mutex.unlock();
+}
+
+void RenderStats::add_cache_access(bool hit) {
+	if (hit) {
+		cache_hits.ref();
+	} else {
+		cache_misses.ref();
+	}
+}
+
+void RenderStats::set_queue_depth(int depth) {
+	mutex.lock();
+	queue_depth = depth;
+	mutex.unlock();
+}
+
+void RenderStats::set_memory_usage(qint64 bytes) {
+	mutex.lock();
+	memory_usage = bytes;
+	mutex.unlock();
+}
+
+void RenderStats::reset() {
+	mutex.lock();
+	for (int i = 0; i < StageCount; i++) {
+		timing[i].count = 0;
+		timing[i].total = 0;
+		timing[i].max = 0;
+	}
+	cache_hits.fetchAndStoreRelaxed(0);
+	cache_misses.fetchAndStoreRelaxed(0);
+	queue_depth = 0;
+	memory_usage = 0;
+	mutex.unlock();
+}
+
+qint64 RenderStats::get_count(enum Stage stage) const {
+	mutex.lock();
+	qint64 count = timing[stage].count;
+	mutex.unlock();
+	return count;
+}
+
+qint64 RenderStats::get_total(enum Stage stage) const {
+	mutex.lock();
+	qint64 total = timing[stage].total;
+	mutex.unlock();
+	return total;
+}
+
+QString RenderStats::get_summary() const {
+	mutex.lock();
+	qint64 hits = cache_hits.fetchAndAddRelaxed(0);
+	qint64 accesses = hits + cache_misses.fetchAndAddRelaxed(0);
+	QString text = QString::fromUtf8("queue %1, hits %2%, %3 MB")
+		.arg(queue_depth)
+		.arg(accesses > 0 ? hits * 100 / accesses : 0)
+		.arg(memory_usage / (1024.0 * 1024.0), 0, 'f', 1);
+	for (int i = 0; i < StageCount; i++) {
+		// average and maximum in milliseconds
+		float avg = timing[i].count > 0 ? timing[i].total / 1e6 / timing[i].count : 0;
+		text += QString::fromUtf8("\n%1: %2 ms avg, %3 ms max (%4)")
+			.arg(QString::fromUtf8(stage_names[i]))
+			.arg(avg, 0, 'f', 1)
+			.arg(timing[i].max / 1e6, 0, 'f', 1)
+			.arg(timing[i].count);
+	}
+	mutex.unlock();
+	return text;
+}
+
+QString RenderStats::to_json() const {
+	mutex.lock();
+	QStringList stages;
+	for (int i = 0; i < StageCount; i++) {
+		stages << QString::fromUtf8("\"%1\": {\"count\": %2, \"total_ms\": %3, \"max_ms\": %4}")
+			.arg(QString::fromUtf8(stage_names[i]))
+			.arg(timing[i].count)
+			.arg(timing[i].total / 1e6, 0, 'f', 3)
+			.arg(timing[i].max / 1e6, 0, 'f', 3);
+	}
+	QString json = QString::fromUtf8("{\"queue_depth\": %1, \"cache_hits\": %2, \"cache_misses\": %3, "
+			"\"memory_bytes\": %4, \"stages\": {%5}}")
+		.arg(queue_depth)
+		.arg(cache_hits.fetchAndAddRelaxed(0))
+		.arg(cache_misses.fetchAndAddRelaxed(0))
+		.arg(memory_usage)
+		.arg(stages.join(QString::fromUtf8(", ")));
+	mutex.unlock();
+	return json;
+}
+
@@ -0,0 +1,59 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <QMutex>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QString>
+
+
+// timings of the render pipeline, collected by all threads
+class RenderStats {
+public:
+	enum Stage {
+		QueueWait,
+		Render,
+		Invert,
+		Thumbnail,
+		TextExtraction,
+		Publish,
+		StageCount
+	};
+
+	static RenderStats *get_instance();
+	// monotonic clock in nanoseconds
+	static qint64 now();
+
+	void add_timing(enum Stage stage, qint64 nsecs);
+	// lock free, called once per drawn page and frame
+	void add_cache_access(bool hit);
+	void set_queue_depth(int depth);
+	void set_memory_usage(qint64 bytes);
+	void reset();
+
+	qint64 get_count(enum Stage stage) const;
+	qint64 get_total(enum Stage stage) const;
+	QString get_summary() const;
+	QString to_json() const;
+
+private:
+	RenderStats();
+
+	struct Timing {
+		qint64 count;
+		qint64 total;
+		qint64 max;
+	};
+
+	QElapsedTimer clock; // started once, before any thread can ask for it
+	Timing timing[StageCount];
+	mutable QAtomicInt cache_hits;
+	mutable QAtomicInt cache_misses;
+	int queue_depth;
+	qint64 memory_usage;
+
+	mutable QMutex mutex;
+};
+
+#endif
+
@@ -0,0 +1,423 @@
+#include "textlayer.h"
+#include <QSet>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+// a gutter needs this many lines of text on both sides
+#define MIN_COLUMN_PARTS 3
+
+
+//==[ layout analysis ]========================================================
+// chain of words while the layout is analyzed
+struct LayoutPart {
+	QList<Poppler::TextBox *> words;
+	QRectF bbox;
+	int band; // vertical section between lines spanning several columns
+	int column;
+};
+
+static bool layout_less_y(const LayoutPart *a, const LayoutPart *b) {
+	return a->bbox.center().y() < b->bbox.center().y();
+}
+
+static bool layout_less_x(const LayoutPart *a, const LayoutPart *b) {
+	return a->bbox.center().x() < b->bbox.center().x();
+}
+
+static bool layout_less_block(const LayoutPart *a, const LayoutPart *b) {
+	if (a->band != b->band) {
+		return a->band < b->band;
+	}
+	return a->column < b->column;
+}
+
+// x coordinates of the gutters between columns, i.e. empty vertical strips
+// that are at least min_width wide and have enough text on both sides
+static QList<float> find_gutters(const vector<LayoutPart *> &parts, float min_width) {
+	QList<float> gutters;
+	if (parts.size() < MIN_COLUMN_PARTS * 2) {
+		return gutters;
+	}
+	QRectF text_box;
+	for (vector<LayoutPart *>::const_iterator it = parts.begin(); it != parts.end(); ++it) {
+		text_box = text_box.united((*it)->bbox);
+	}
+	int bins = ceil(text_box.width()) + 1;
+
+	// coverage per point of width, lines wider than half the text (titles,
+	// abstracts) would hide the gutters
+	vector<int> coverage(bins + 1, 0);
+	int narrow = 0;
+	for (vector<LayoutPart *>::const_iterator it = parts.begin(); it != parts.end(); ++it) {
+		QRectF box = (*it)->bbox;
+		if (box.width() > text_box.width() / 2) {
+			continue;
+		}
+		coverage[(int) floor(box.left() - text_box.left())]++;
+		coverage[(int) ceil(box.right() - text_box.left())]--;
+		narrow++;
+	}
+	for (int x = 1; x < bins; x++) {
+		coverage[x] += coverage[x - 1];
+	}
+
+	// empty runs between text, the borders don't count
+	QList<float> candidates;
+	int run_start = -1;
+	for (int x = 0; x < bins; x++) {
+		if (coverage[x] == 0) {
+			if (run_start == -1) {
+				run_start = x;
+			}
+		} else {
+			if (run_start > 0 && x - run_start >= min_width) {
+				candidates.push_back(text_box.left() + (run_start + x) / 2.0f);
+			}
+			run_start = -1;
+		}
+	}
+
+	// a table cell or a short indented line is no column
+	int min_parts = max(MIN_COLUMN_PARTS, narrow / 10);
+	Q_FOREACH(float gutter, candidates) {
+		int left = 0, right = 0;
+		for (vector<LayoutPart *>::const_iterator it = parts.begin(); it != parts.end(); ++it) {
+			QRectF box = (*it)->bbox;
+			if (box.width() > text_box.width() / 2) {
+				continue;
+			}
+			if (box.center().x() < gutter) {
+				left++;
+			} else {
+				right++;
+			}
+		}
+		if (left >= min_parts && right >= min_parts) {
+			gutters.push_back(gutter);
+		}
+	}
+	return gutters;
+}
+
+
+//==[ TextLayer ]==============================================================
+void TextLayer::Box::set(const QRectF &r) {
+	left = r.left();
+	top = r.top();
+	right = r.right();
+	bottom = r.bottom();
+}
+
+QRectF TextLayer::Box::to_rect() const {
+	return QRectF(QPointF(left, top), QPointF(right, bottom));
+}
+
+TextLayer::TextLayer(const QList<Poppler::TextBox *> &boxes) {
+	// make single parts from chained boxes, starting at the heads of the chains
+	QSet<Poppler::TextBox *> chained;
+	Q_FOREACH(Poppler::TextBox *box, boxes) {
+		if (box->nextWord() != NULL) {
+			chained.insert(box->nextWord());
+		}
+	}
+	vector<LayoutPart *> layout;
+	vector<float> heights;
+	int char_count = 0;
+	Q_FOREACH(Poppler::TextBox *box, boxes) {
+		if (chained.contains(box)) {
+			continue;
+		}
+		LayoutPart *p = new LayoutPart;
+		for (Poppler::TextBox *next = box; next != NULL; next = next->nextWord()) {
+			if (next->text().isEmpty()) {
+				continue;
+			}
+			p->words.push_back(next);
+			p->bbox = p->bbox.united(next->boundingBox());
+			char_count += next->text().size();
+		}
+		if (p->words.empty()) {
+			delete p;
+			continue;
+		}
+		layout.push_back(p);
+		heights.push_back(p->bbox.height());
+	}
+
+	// reserve the upper bounds, avoids reallocations while building
+	text.reserve(char_count);
+	chars.reserve(char_count);
+	words.reserve(boxes.size() + 1);
+	parts.reserve(layout.size() + 1);
+	lines.reserve(layout.size() + 1);
+	blocks.reserve(layout.size() + 1);
+
+	if (!layout.empty()) {
+		// columns are separated by gaps of at least one (median) line height
+		nth_element(heights.begin(), heights.begin() + heights.size() / 2, heights.end());
+		float line_height = heights[heights.size() / 2];
+		QList<float> gutters = find_gutters(layout, line_height);
+
+		// sort by y coordinate
+		stable_sort(layout.begin(), layout.end(), layout_less_y);
+
+		// assign columns and bands, spanning lines start a new band
+		int band = 0;
+		bool prev_spanning = false;
+		for (vector<LayoutPart *>::iterator it = layout.begin(); it != layout.end(); ++it) {
+			LayoutPart *l = *it;
+			l->column = 0;
+			bool spanning = false;
+			Q_FOREACH(float gutter, gutters) {
+				if (l->bbox.left() < gutter && l->bbox.right() > gutter) {
+					spanning = true;
+				} else if (l->bbox.center().x() > gutter) {
+					l->column++;
+				}
+			}
+			if (spanning) {
+				l->column = 0;
+			}
+			if (it != layout.begin() && spanning != prev_spanning) {
+				band++;
+			}
+			prev_spanning = spanning;
+			l->band = band;
+		}
+		// reading order, stays sorted by y within a column
+		stable_sort(layout.begin(), layout.end(), layout_less_block);
+
+		// build lines within blocks
+		QList<LayoutPart *> line;
+		QRectF line_box;
+		int block = -1;
+		int prev_band = -1, prev_column = -1;
+		for (vector<LayoutPart *>::const_iterator it = layout.begin(); it != layout.end(); ++it) {
+			QRectF box = (*it)->bbox;
+			bool new_block = (*it)->band != prev_band || (*it)->column != prev_column;
+			// box fits into line_box's line
+			bool fits = !new_block && box.y() <= line_box.center().y() && box.bottom() > line_box.center().y();
+			if (fits) {
+				float ratio_w = box.width() / line_box.width();
+				float ratio_h = box.height() / line_box.height();
+				if (ratio_w < 1.0f) {
+					ratio_w = 1.0f / ratio_w;
+				}
+				if (ratio_h < 1.0f) {
+					ratio_h = 1.0f / ratio_h;
+				}
+				fits = ratio_w <= 1.3f || ratio_h <= 1.3f;
+			}
+			if (fits) {
+				line.push_back(*it);
+			// it doesn't fit, create new line
+			} else {
+				if (!line.empty()) {
+					stable_sort(line.begin(), line.end(), layout_less_x);
+					add_line(line, block);
+				}
+				if (new_block) {
+					block++;
+					prev_band = (*it)->band;
+					prev_column = (*it)->column;
+				}
+				line.clear();
+				line.push_back(*it);
+				line_box = box;
+			}
+		}
+		stable_sort(line.begin(), line.end(), layout_less_x);
+		add_line(line, block);
+	}
+
+	// sentinels
+	Block b;
+	b.first_line = lines.size();
+	blocks.push_back(b);
+	Word w;
+	w.first_char = chars.size();
+	words.push_back(w);
+	Part p;
+	p.first_word = words.size() - 1;
+	parts.push_back(p);
+	Line l;
+	l.first_part = parts.size() - 1;
+	lines.push_back(l);
+
+	// the boxes are not needed anymore
+	for (vector<LayoutPart *>::iterator it = layout.begin(); it != layout.end(); ++it) {
+		delete *it;
+	}
+	Q_FOREACH(Poppler::TextBox *box, boxes) {
+		delete box;
+	}
+	text.squeeze();
+	chars.squeeze();
+	words.squeeze();
+	parts.squeeze();
+	lines.squeeze();
+	blocks.squeeze();
+}
+
+void TextLayer::add_line(const QList<LayoutPart *> &line_parts, int block) {
+	Line l;
+	l.first_part = parts.size();
+	l.block = block;
+	QRectF line_box;
+	Q_FOREACH(const LayoutPart *lp, line_parts) {
+		Part p;
+		p.bbox.set(lp->bbox);
+		p.first_word = words.size();
+		parts.push_back(p);
+		line_box = line_box.united(lp->bbox);
+
+		Q_FOREACH(Poppler::TextBox *box, lp->words) {
+			Word w;
+			QRectF word_box = box->boundingBox();
+			w.bbox.set(word_box);
+			w.first_char = chars.size();
+			w.space_after = box->hasSpaceAfter();
+			words.push_back(w);
+
+			QString t = box->text();
+			text += t;
+			for (int i = 0; i < t.size(); i++) {
+				QRectF r = box->charBoundingBox(i);
+				Extent e;
+				if (r.isNull()) {
+					// no box for the second half of a surrogate pair
+					e.left = word_box.right();
+					e.right = word_box.right();
+					if (!chars.empty() && i > 0) {
+						e.left = chars.back().left;
+						e.right = chars.back().right;
+					}
+				} else {
+					e.left = r.left();
+					e.right = r.right();
+				}
+				chars.push_back(e);
+			}
+		}
+	}
+	l.bbox.set(line_box);
+	lines.push_back(l);
+
+	if (block == blocks.size()) {
+		Block b;
+		b.bbox = l.bbox;
+		b.first_line = lines.size() - 1;
+		blocks.push_back(b);
+	} else {
+		blocks.back().bbox.set(blocks.back().bbox.to_rect().united(line_box));
+	}
+}
+
+int TextLayer::get_block_count() const {
+	return blocks.size() - 1;
+}
+
+QRectF TextLayer::get_block_bbox(int block) const {
+	return blocks[block].bbox.to_rect();
+}
+
+int TextLayer::get_first_line(int block) const {
+	return blocks[block].first_line;
+}
+
+int TextLayer::get_line_count() const {
+	return lines.size() - 1;
+}
+
+QRectF TextLayer::get_line_bbox(int line) const {
+	return lines[line].bbox.to_rect();
+}
+
+int TextLayer::get_line_block(int line) const {
+	return lines[line].block;
+}
+
+int TextLayer::get_first_part(int line) const {
+	return lines[line].first_part;
+}
+
+QRectF TextLayer::get_part_bbox(int part) const {
+	return parts[part].bbox.to_rect();
+}
+
+float TextLayer::get_part_left(int part) const {
+	return parts[part].bbox.left;
+}
+
+float TextLayer::get_part_right(int part) const {
+	return parts[part].bbox.right;
+}
+
+int TextLayer::get_first_word(int part) const {
+	return parts[part].first_word;
+}
+
+int TextLayer::get_word_count() const {
+	return words.size() - 1;
+}
+
+QRectF TextLayer::get_word_bbox(int word) const {
+	return words[word].bbox.to_rect();
+}
+
+float TextLayer::get_word_left(int word) const {
+	return words[word].bbox.left;
+}
+
+float TextLayer::get_word_right(int word) const {
+	return words[word].bbox.right;
+}
+
+bool TextLayer::has_space_after(int word) const {
+	return words[word].space_after;
+}
+
+int TextLayer::get_first_char(int word) const {
+	return words[word].first_char;
+}
+
+int TextLayer::get_char_count() const {
+	return chars.size();
+}
+
+float TextLayer::get_char_left(int c) const {
+	return chars[c].left;
+}
+
+float TextLayer::get_char_right(int c) const {
+	return chars[c].right;
+}
+
+QString TextLayer::get_text(int from, int to) const {
+	if (to <= from) {
+		return QString();
+	}
+	return text.mid(from, to - from);
+}
+
+void TextLayer::append_text(QString &out, int from, int to) const {
+	if (to <= from) {
+		return;
+	}
+	out += text.midRef(from, to - from);
+}
+
+qint64 TextLayer::get_memory_usage() const {
+	return sizeof(TextLayer) +
+		blocks.capacity() * sizeof(Block) +
+		lines.capacity() * sizeof(Line) +
+		parts.capacity() * sizeof(Part) +
+		words.capacity() * sizeof(Word) +
+		chars.capacity() * sizeof(Extent) +
+		text.capacity() * sizeof(QChar);
+}
+
@@ -0,0 +1,101 @@
+#ifndef TEXTLAYER_H
+#define TEXTLAYER_H
+
+#include <QString>
+#include <QVector>
+#include <QRectF>
+#if QT_VERSION >= 0x050000
+#	include <poppler-qt5.h>
+#else
+#	include <poppler-qt4.h>
+#endif
+
+struct LayoutPart;
+
+
+// all text of a page in a few flat arrays instead of one object per word
+// lines consist of parts (chains of words), parts of words, words of
+// characters; every level stores the index of its first child, the children
+// of element i are [get_first_*(i), get_first_*(i + 1))
+// lines are in reading order: sorted by block (column), by y within a block
+class TextLayer {
+public:
+	// layout analysis, deletes the boxes
+	TextLayer(const QList<Poppler::TextBox *> &boxes);
+
+	// blocks are consecutive lines of a column
+	int get_block_count() const;
+	QRectF get_block_bbox(int block) const;
+	int get_first_line(int block) const;
+
+	int get_line_count() const;
+	QRectF get_line_bbox(int line) const;
+	int get_line_block(int line) const;
+	int get_first_part(int line) const;
+
+	// parts of a line and words of a part are sorted from left to right
+	QRectF get_part_bbox(int part) const;
+	float get_part_left(int part) const;
+	float get_part_right(int part) const;
+	int get_first_word(int part) const;
+
+	int get_word_count() const;
+	QRectF get_word_bbox(int word) const;
+	float get_word_left(int word) const;
+	float get_word_right(int word) const;
+	bool has_space_after(int word) const;
+	int get_first_char(int word) const;
+
+	int get_char_count() const;
+	float get_char_left(int c) const;
+	float get_char_right(int c) const;
+	// characters [from, to)
+	QString get_text(int from, int to) const;
+	void append_text(QString &out, int from, int to) const;
+
+	qint64 get_memory_usage() const;
+
+private:
+	// half the size of a QRectF
+	struct Box {
+		float left, top, right, bottom;
+
+		void set(const QRectF &r);
+		QRectF to_rect() const;
+	};
+	struct Block {
+		Box bbox;
+		int first_line;
+	};
+	struct Line {
+		Box bbox;
+		int first_part;
+		int block;
+	};
+	struct Part {
+		Box bbox;
+		int first_word;
+	};
+	struct Word {
+		Box bbox;
+		int first_char;
+		bool space_after;
+	};
+	// characters share top and bottom with their word
+	struct Extent {
+		float left, right;
+	};
+
+	void add_line(const QList<LayoutPart *> &line_parts, int block);
+
+	// each with a sentinel at the end
+	QVector<Block> blocks;
+	QVector<Line> lines;
+	QVector<Part> parts;
+	QVector<Word> words;
+	QVector<Extent> chars;
+	QString text;
+};
+
+#endif
+
@@ -0,0 +1,165 @@
+#include <QPainter>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <cmath>
+#include <iostream>
+#include "thumbnailcache.h"
+#include "config.h"
+#include "util.h"
+
+using namespace std;
+
+
+ThumbnailCache::ThumbnailCache(const QString &file, const QList<QSizeF> &page_sizes, int pixels) :
+		page_count(page_sizes.size()),
+		done(page_count, false),
+		done_count(0),
+		saved(false) {
+	// width * height = pixels, width / height = aspect
+	vector<QSize> sizes;
+	double area = 0;
+	int atlas_width = 1;
+	for (int page = 0; page < page_count; page++) {
+		QSizeF page_size = page_sizes[page];
+		float aspect = 1;
+		if (page_size.width() > 0 && page_size.height() > 0) {
+			aspect = page_size.width() / page_size.height();
+		}
+		QSize size(ROUND(sqrt(pixels * aspect)), ROUND(sqrt(pixels / aspect)));
+		size = size.expandedTo(QSize(1, 1));
+		sizes.push_back(size);
+		area += size.width() * size.height();
+		atlas_width = max(atlas_width, size.width());
+	}
+
+	// roughly square atlas; a new row starts when the thumbnail does not fit,
+	// so mixed page sizes only waste space below the lower ones of a row
+	atlas_width = max(atlas_width, (int) ceil(sqrt(area)));
+	int x = 0, y = 0, row_height = 0;
+	for (int page = 0; page < page_count; page++) {
+		if (x + sizes[page].width() > atlas_width) {
+			x = 0;
+			y += row_height;
+			row_height = 0;
+		}
+		rects.push_back(QRect(QPoint(x, y), sizes[page]));
+		x += sizes[page].width();
+		row_height = max(row_height, sizes[page].height());
+	}
+	atlas = QImage(atlas_width, max(y + row_height, 1), QImage::Format_RGB32);
+	atlas.fill(0xffffffff);
+	atlas_inverted = atlas.copy();
+
+	if (CFG::get_instance()->get_value("Settings/thumbnail_disk_cache").toBool()) {
+		QString dir = get_cache_dir(QString::fromUtf8("thumbnails"));
+		QFileInfo info(file);
+		if (!dir.isEmpty() && info.exists()) {
+			// a changed document, pixel budget or atlas layout gets a new cache file
+			QString key = QString::fromUtf8("%1 %2 %3 %4 %5 rows")
+				.arg(info.absoluteFilePath())
+				.arg(info.lastModified().toMSecsSinceEpoch())
+				.arg(info.size())
+				.arg(pixels)
+				.arg(page_count);
+			QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+			cache_file = dir + QString::fromUtf8("/") + QString::fromLatin1(hash) + QString::fromUtf8(".png");
+		}
+	}
+}
+
+QSize ThumbnailCache::get_size(int page) const {
+	return rects[page].size();
+}
+
+bool ThumbnailCache::has(int page) const {
+	return done[page];
+}
+
+bool ThumbnailCache::is_complete() const {
+	return done_count == page_count;
+}
+
+int ThumbnailCache::next_missing(int center) const {
+	if (is_complete()) {
+		return -1;
+	}
+	// alternate around the center, like the worker does for requests
+	for (int d = 0; d < page_count; d++) {
+		if (center + d < page_count && center + d >= 0 && !done[center + d]) {
+			return center + d;
+		}
+		if (center - d - 1 >= 0 && center - d - 1 < page_count && !done[center - d - 1]) {
+			return center - d - 1;
+		}
+	}
+	for (int page = 0; page < page_count; page++) {
+		if (!done[page]) {
+			return page;
+		}
+	}
+	return -1;
+}
+
+void ThumbnailCache::insert(int page, const QImage &img) {
+	QImage inverted = img.convertToFormat(QImage::Format_RGB32);
+	invert_image(&inverted);
+
+	QRect r = rects[page];
+	QPainter painter(&atlas);
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+	painter.drawImage(r, img);
+	painter.end();
+	painter.begin(&atlas_inverted);
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+	painter.drawImage(r, inverted);
+	painter.end();
+
+	if (!done[page]) {
+		done[page] = true;
+		done_count++;
+	}
+}
+
+QImage ThumbnailCache::get(int page, bool inverted) const {
+	if (!done[page]) {
+		return QImage();
+	}
+	// the worker paints other thumbnails into the atlas while the gui
+	// draws this one, so it must not share the memory
+	const QImage &source = inverted ? atlas_inverted : atlas;
+	return source.copy(rects[page]);
+}
+
+bool ThumbnailCache::load() {
+	if (cache_file.isEmpty() || !QFileInfo(cache_file).exists()) {
+		return false;
+	}
+	QImage img(cache_file);
+	if (img.size() != atlas.size()) {
+		cerr << "ignoring broken thumbnail cache " << cache_file.toUtf8().constData() << endl;
+		return false;
+	}
+	atlas = img.convertToFormat(QImage::Format_RGB32);
+	atlas_inverted = atlas.copy();
+	invert_image(&atlas_inverted);
+	for (int page = 0; page < page_count; page++) {
+		done[page] = true;
+	}
+	done_count = page_count;
+	saved = true;
+	return true;
+}
+
+bool ThumbnailCache::save() {
+	if (cache_file.isEmpty() || saved || !is_complete()) {
+		return false;
+	}
+	saved = true;
+	if (!atlas.save(cache_file)) {
+		cerr << "failed to write " << cache_file.toUtf8().constData() << endl;
+		return false;
+	}
+	return true;
+}
+
@@ -0,0 +1,49 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QList>
+#include <vector>
+
+
+// small versions of all pages, packed into one atlas image per color version
+// only the worker thread uses the cache, the gui sees copies of the
+// thumbnails through KPage
+class ThumbnailCache {
+public:
+	// every thumbnail keeps the page aspect ratio and has about pixels pixels
+	ThumbnailCache(const QString &file, const QList<QSizeF> &page_sizes, int pixels);
+
+	// size of the thumbnail of an unrotated page
+	QSize get_size(int page) const;
+	bool has(int page) const;
+	bool is_complete() const;
+	// missing page closest to center, -1 if there is none
+	int next_missing(int center) const;
+
+	// img should have get_size(page), the inverted version is generated
+	void insert(int page, const QImage &img);
+	// a copy, the atlas keeps changing while thumbnails are inserted
+	QImage get(int page, bool inverted) const;
+
+	// disk cache, does nothing if it is disabled
+	bool load();
+	bool save();
+
+private:
+	QString cache_file; // empty if the disk cache is disabled
+	int page_count;
+	// position in the atlas, packed into rows as high as their highest thumbnail
+	std::vector<QRect> rects;
+
+	QImage atlas;
+	QImage atlas_inverted;
+	std::vector<bool> done;
+	int done_count;
+	bool saved;
+};
+
+#endif
+
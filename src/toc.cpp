@@ -3,22 +3,455 @@
 #include <QDomDocument>
 #include <QDomNode>
 #include <QHeaderView>
+#include <QLineEdit>
+#include <QTreeView>
+#include <QVBoxLayout>
+#include <QItemSelectionModel>
 #include "toc.h"
 #include "viewer.h"
 #include "canvas.h"
 #include "layout/layout.h"
 #include "resourcemanager.h"
+#include "trace.h"
 #include "util.h"
+#include <vector>
+#include <algorithm>
+#if QT_VERSION >= 0x050000
+#	include <poppler-qt5.h>
+#else
+#	include <poppler-qt4.h>
+#endif
+
+
+// internal id of model indices, the entry
+#if QT_VERSION >= 0x050000
+typedef quintptr EntryId;
+#else
+typedef quint32 EntryId;
+#endif
+
+
+//==[ TocTree ]================================================================
+TocTree::TocTree() {
+	// invisible root
+	Entry root;
+	root.named = false;
+	root.parent = -1;
+	root.row = 0;
+	root.first_child = 0;
+	root.child_count = 0;
+	root.page = -1;
+	entries.push_back(root);
+}
+
+void TocTree::build_page_index() {
+	std::vector<std::pair<int, int> > index;
+	for (int i = 1; i < entries.size(); i++) {
+		if (entries[i].page >= 1) {
+			index.push_back(std::make_pair(entries[i].page, i));
+		}
+	}
+	// entries are in document order, equal pages keep it
+	std::sort(index.begin(), index.end());
+
+	index_pages.resize(index.size());
+	page_entries.resize(index.size());
+	for (unsigned int i = 0; i < index.size(); i++) {
+		index_pages[i] = index[i].first;
+		page_entries[i] = index[i].second;
+	}
+}
+
+int TocTree::find_entry(int page) const {
+	QVector<int>::const_iterator it = std::upper_bound(index_pages.begin(), index_pages.end(), page);
+	if (it == index_pages.begin()) {
+		return -1;
+	}
+	return page_entries[it - index_pages.begin() - 1];
+}
+
+
+//==[ TocLoader ]==============================================================
+TocLoader::TocLoader(const QString &file, const QByteArray &password) :
+		abort(false),
+		file(file),
+		password(password),
+		doc(NULL),
+		tree(NULL),
+		built(NULL) {
+}
+
+TocLoader::~TocLoader() {
+	wait();
+	delete tree;
+	delete built;
+}
+
+void TocLoader::run() {
+	Trace::get_instance()->set_thread_name("toc loader");
+	TRACE_SPAN("load toc", "toc");
+	TocTree *result = new TocTree();
+	tree = result;
+
+	doc = Poppler::Document::load(file, QByteArray(), password);
+	if (doc != NULL && !doc->isLocked()) {
+		QDomDocument *contents = doc->toc();
+		if (contents != NULL) {
+			build(*contents, 0);
+			delete contents;
+		}
+	}
+	if (abort) {
+		delete doc;
+		doc = NULL;
+		return;
+	}
+	result->entries.squeeze();
+	result->children.squeeze();
+	// show the tree before looking up named destinations
+	result->build_page_index();
+	built = new TocTree(*result);
+	emit tree_built();
+
+	if (doc != NULL) {
+		TRACE_SPAN("resolve toc pages", "toc");
+		for (int i = 1; i < result->entries.size() && !abort; i++) {
+			if (result->entries[i].named) {
+				result->entries[i].page = resolve_page(result->entries[i]);
+			}
+		}
+		delete doc;
+		doc = NULL;
+	}
+	result->build_page_index();
+}
+
+TocTree *TocLoader::take_tree() {
+	TocTree *t = built;
+	built = NULL;
+	return t;
+}
+
+TocTree *TocLoader::take_resolved_tree() {
+	if (!isFinished()) {
+		return NULL;
+	}
+	TocTree *t = tree;
+	tree = NULL;
+	return t;
+}
+
+void TocLoader::build(const QDomNode &node, int parent) {
+	if (node.isNull() || !node.hasChildNodes()) {
+		return;
+	}
+
+	QDomNodeList list = node.childNodes();
+	// reserve the slots of all children, grandchildren are appended behind
+	int first_child = tree->children.size();
+	tree->entries[parent].first_child = first_child;
+	tree->entries[parent].child_count = list.count();
+	tree->children.resize(first_child + list.count());
+
+	for (int i = 0; i < list.count() && !abort; i++) {
+		QDomNode n = list.at(i);
+
+		TocTree::Entry e;
+		e.title = n.nodeName();
+		// explicit destinations contain their page, named ones need a lookup
+		// in the document and are resolved after the tree is shown
+		QDomNamedNodeMap attributes = n.attributes();
+		QDomNode dest = attributes.namedItem(QString::fromUtf8("Destination"));
+		e.named = false;
+		if (dest.isNull()) {
+			dest = attributes.namedItem(QString::fromUtf8("DestinationName"));
+			e.named = true;
+		}
+		if (!dest.isNull()) {
+			e.destination = dest.nodeValue();
+		}
+		// TODO check "ExternalFileName"
+		// TODO take "Open" into account?
+		e.parent = parent;
+		e.row = i;
+		e.first_child = 0;
+		e.child_count = 0;
+		e.page = e.named ? -1 : resolve_page(e);
 
+		int entry = tree->entries.size();
+		tree->entries.push_back(e);
+		tree->children[first_child + i] = entry;
 
-Q_DECLARE_METATYPE(Poppler::LinkDestination *)
+		build(n, entry);
+	}
+}
 
 
+int TocLoader::resolve_page(const TocTree::Entry &e) const {
+	if (e.destination.isEmpty()) {
+		return -1;
+	}
+	if (e.named) {
+		Poppler::LinkDestination *link = doc->linkDestination(e.destination);
+		if (link == NULL) {
+			return -1;
+		}
+		int page = link->pageNumber();
+		delete link;
+		return page;
+	}
+	return Poppler::LinkDestination(e.destination).pageNumber();
+}
+
+
+//==[ TocModel ]===============================================================
+TocModel::TocModel(Viewer *v, QObject *parent) :
+		QAbstractItemModel(parent),
+		viewer(v),
+		tree(NULL) {
+}
+
+TocModel::~TocModel() {
+	delete tree;
+}
+
+void TocModel::set_tree(TocTree *new_tree) {
+	beginResetModel();
+	delete tree;
+	tree = new_tree;
+	update_matches();
+	endResetModel();
+}
+
+void TocModel::set_pages(const TocTree &resolved) {
+	if (tree == NULL || tree->entries.size() != resolved.entries.size()) {
+		return;
+	}
+	// only the page column changes, indices stay valid
+	emit layoutAboutToBeChanged();
+	for (int i = 0; i < tree->entries.size(); i++) {
+		tree->entries[i].page = resolved.entries[i].page;
+	}
+	tree->index_pages = resolved.index_pages;
+	tree->page_entries = resolved.page_entries;
+	emit layoutChanged();
+}
+
+void TocModel::set_placeholder(const QString &text) {
+	beginResetModel();
+	placeholder = text;
+	endResetModel();
+}
+
+void TocModel::set_filter(const QString &text) {
+	beginResetModel();
+	filter = text;
+	update_matches();
+	endResetModel();
+}
+
+void TocModel::update_matches() {
+	matches.clear();
+	if (tree == NULL || !is_filtered()) {
+		return;
+	}
+	// smartcase, like the search bar
+	Qt::CaseSensitivity cs = Qt::CaseInsensitive;
+	for (QString::const_iterator it = filter.begin(); it != filter.end(); ++it) {
+		if (it->isUpper()) {
+			cs = Qt::CaseSensitive;
+			break;
+		}
+	}
+	for (int i = 1; i < tree->entries.size(); i++) {
+		if (tree->entries[i].title.contains(filter, cs)) {
+			matches.push_back(i);
+		}
+	}
+}
+
+bool TocModel::is_filtered() const {
+	return !filter.isEmpty();
+}
+
+int TocModel::get_top_level_count() const {
+	if (tree == NULL) {
+		return 0;
+	}
+	if (is_filtered()) {
+		return matches.size();
+	}
+	return tree->entries[0].child_count;
+}
+
+int TocModel::get_entry(const QModelIndex &index) const {
+	if (!index.isValid() || index.internalId() == 0) {
+		return -1;
+	}
+	return (int) index.internalId();
+}
+
+Poppler::LinkDestination *TocModel::get_destination(int entry) const {
+	if (tree == NULL || entry <= 0 || entry >= tree->entries.size()) {
+		return NULL;
+	}
+	const TocTree::Entry &e = tree->entries[entry];
+	if (e.destination.isEmpty()) {
+		return NULL;
+	}
+	if (e.named) {
+		const Poppler::LinkDestination *link = viewer->get_res()->resolve_link_destination(e.destination);
+		if (link == NULL) {
+			return NULL;
+		}
+		return new Poppler::LinkDestination(*link);
+	}
+	return new Poppler::LinkDestination(e.destination);
+}
+
+QModelIndex TocModel::get_index(int entry) const {
+	if (tree == NULL || entry <= 0 || entry >= tree->entries.size()) {
+		return QModelIndex();
+	}
+	if (is_filtered()) {
+		// matches are sorted
+		QVector<int>::const_iterator it = std::lower_bound(matches.begin(), matches.end(), entry);
+		if (it == matches.end() || *it != entry) {
+			return QModelIndex();
+		}
+		return createIndex(it - matches.begin(), 0, (EntryId) entry);
+	}
+	return createIndex(tree->entries[entry].row, 0, (EntryId) entry);
+}
+
+int TocModel::find_entry(int page) const {
+	if (tree == NULL) {
+		return -1;
+	}
+	return tree->find_entry(page);
+}
+
+QModelIndex TocModel::index(int row, int column, const QModelIndex &parent) const {
+	if (row < 0 || column < 0 || column >= 2) {
+		return QModelIndex();
+	}
+	if (!parent.isValid() && get_top_level_count() == 0) {
+		// the placeholder uses the id of the invisible root
+		if (row == 0 && !placeholder.isEmpty()) {
+			return createIndex(row, column, (EntryId) 0);
+		}
+		return QModelIndex();
+	}
+	if (is_filtered()) {
+		if (parent.isValid() || row >= matches.size()) {
+			return QModelIndex();
+		}
+		return createIndex(row, column, (EntryId) matches[row]);
+	}
+	int parent_entry = parent.isValid() ? get_entry(parent) : 0;
+	if (tree == NULL || parent_entry == -1) {
+		return QModelIndex();
+	}
+	const TocTree::Entry &p = tree->entries[parent_entry];
+	if (row >= p.child_count) {
+		return QModelIndex();
+	}
+	return createIndex(row, column, (EntryId) tree->children[p.first_child + row]);
+}
+
+QModelIndex TocModel::parent(const QModelIndex &index) const {
+	int entry = get_entry(index);
+	if (entry == -1 || is_filtered()) {
+		return QModelIndex();
+	}
+	int parent = tree->entries[entry].parent;
+	if (parent == 0) {
+		return QModelIndex();
+	}
+	return createIndex(tree->entries[parent].row, 0, (EntryId) parent);
+}
+
+int TocModel::rowCount(const QModelIndex &parent) const {
+	if (parent.column() > 0) {
+		return 0;
+	}
+	if (!parent.isValid()) {
+		int count = get_top_level_count();
+		if (count == 0 && !placeholder.isEmpty()) {
+			return 1;
+		}
+		return count;
+	}
+	int entry = get_entry(parent);
+	if (entry == -1 || is_filtered()) {
+		return 0;
+	}
+	return tree->entries[entry].child_count;
+}
+
+int TocModel::columnCount(const QModelIndex &/*parent*/) const {
+	return 2;
+}
+
+QVariant TocModel::data(const QModelIndex &index, int role) const {
+	if (!index.isValid()) {
+		return QVariant();
+	}
+	int entry = get_entry(index);
+	if (role == Qt::TextAlignmentRole && index.column() == 1) {
+		return (int) (Qt::AlignRight | Qt::AlignVCenter);
+	}
+	if (role != Qt::DisplayRole) {
+		return QVariant();
+	}
+	if (entry == -1) {
+		return index.column() == 0 ? placeholder : QString();
+	}
+	if (index.column() == 0) {
+		return tree->entries[entry].title;
+	}
+	int page = tree->entries[entry].page;
+	if (page < 0) {
+		return QString();
+	}
+	return QString::number(page);
+}
+
+QVariant TocModel::headerData(int section, Qt::Orientation orientation, int role) const {
+	if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section == 0) {
+		return QString::fromUtf8("Contents");
+	}
+	return QVariant();
+}
+
+Qt::ItemFlags TocModel::flags(const QModelIndex &index) const {
+	if (get_entry(index) == -1) {
+		return Qt::NoItemFlags;
+	}
+	return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
+
+//==[ Toc ]====================================================================
 Toc::Toc(Viewer *v, QWidget *parent) :
-		QTreeWidget(parent), viewer(v) {
-	setColumnCount(2);
+		QWidget(parent),
+		viewer(v),
+		current_page(0),
+		current_entry(-1),
+		loader(NULL) {
+	filter = new QLineEdit(this);
+#if QT_VERSION >= 0x040700
+	filter->setPlaceholderText(QString::fromUtf8("Filter"));
+#endif
 
-	QHeaderView *h = header();
+	model = new TocModel(viewer, this);
+	view = new QTreeView(this);
+	view->setModel(model);
+	view->setAlternatingRowColors(true);
+	view->setUniformRowHeights(true); // no need to measure every row
+	view->installEventFilter(this);
+
+	QHeaderView *h = view->header();
 	h->setStretchLastSection(false);
 #if QT_VERSION >= 0x050000
 	h->setSectionResizeMode(0, QHeaderView::Stretch);
@@ -28,62 +461,130 @@ Toc::Toc(Viewer *v, QWidget *parent) :
 	h->setResizeMode(1, QHeaderView::ResizeToContents);
 #endif
 
-	QStringList list = QStringList() << QString::fromUtf8("Contents") << QString();
-	setHeaderLabels(list);
+	layout = new QVBoxLayout();
+	layout->setContentsMargins(0, 0, 0, 0);
+	layout->setSpacing(0);
+	layout->addWidget(filter);
+	layout->addWidget(view);
+	setLayout(layout);
+	setFocusProxy(view);
 
-	setAlternatingRowColors(true);
+	connect(view, SIGNAL(activated(const QModelIndex &)), this, SLOT(goto_link(const QModelIndex &)), Qt::UniqueConnection);
+	connect(filter, SIGNAL(textChanged(const QString &)), this, SLOT(set_filter(const QString &)), Qt::UniqueConnection);
 
-	connect(this, SIGNAL(itemActivated(QTreeWidgetItem *, int)), this, SLOT(goto_link(QTreeWidgetItem *, int)), Qt::UniqueConnection);
+	load(viewer->get_res()->get_file(), QByteArray());
+}
 
-	init();
+Toc::~Toc() {
+	shutdown();
+	delete layout;
 }
 
-void Toc::init() {
+void Toc::load(const QString &file, const QByteArray &password) {
 	shutdown();
 
-	QDomDocument *contents = viewer->get_res()->get_toc();
-	if (contents != NULL) {
-		build(contents, invisibleRootItem());
-		delete contents;
+	// the outline is converted in the background, the old one would refer
+	// to the previous document
+	model->set_tree(NULL);
+	current_entry = -1;
+	if (file.isEmpty()) {
+		model->set_placeholder(QString::fromUtf8("(empty)"));
+		return;
 	}
+	model->set_placeholder(QString::fromUtf8("(loading)"));
+	loader = new TocLoader(file, password);
+	connect(loader, SIGNAL(tree_built()), this, SLOT(tree_loaded()), Qt::UniqueConnection);
+	connect(loader, SIGNAL(finished()), this, SLOT(pages_loaded()), Qt::UniqueConnection);
+	loader->start();
+}
 
-	// indicate empty toc
-	if (topLevelItemCount() == 0) {
-		QTreeWidgetItem *item = new QTreeWidgetItem(invisibleRootItem(), QStringList(QString::fromUtf8("(empty)")));
-		item->setFlags(Qt::NoItemFlags);
+void Toc::shutdown() {
+	if (loader != NULL) {
+		// poppler can not be interrupted, only wait for the current call
+		loader->abort = true;
 	}
+	delete loader;
+	loader = NULL;
 }
 
-Toc::~Toc() {
-	shutdown();
+void Toc::tree_loaded() {
+	// signals of a replaced loader arrive late
+	if (loader == NULL || sender() != loader) {
+		return;
+	}
+	TocTree *tree = loader->take_tree();
+	if (tree == NULL) {
+		return;
+	}
+	model->set_placeholder(QString::fromUtf8("(empty)"));
+	model->set_tree(tree);
+	current_entry = -1;
+	update_current_entry();
 }
 
-void Toc::shutdown() {
-	QTreeWidgetItemIterator it(this);
-	while (*it) {
-		delete (*it)->data(0, Qt::UserRole).value<Poppler::LinkDestination *>();
-		++it;
+void Toc::pages_loaded() {
+	if (loader == NULL || sender() != loader) {
+		return;
 	}
+	TocTree *tree = loader->take_resolved_tree();
+	if (tree == NULL) {
+		return;
+	}
+	model->set_pages(*tree);
+	delete tree;
+	update_current_entry();
+}
 
-	clear();
+void Toc::set_filter(const QString &text) {
+	model->set_filter(text);
+	current_entry = -1; // the model was reset
+	update_current_entry();
 }
 
-void Toc::goto_link(QTreeWidgetItem *item, int column) {
-	if (column == -1) {
+void Toc::set_current_page(int page) {
+	current_page = page;
+	update_current_entry();
+}
+
+void Toc::update_current_entry() {
+	// catches up in showEvent()
+	if (!isVisible()) {
+		return;
+	}
+	int entry = model->find_entry(current_page + 1);
+	if (entry == current_entry) {
 		return;
 	}
-	// handle empty-indicator
-	if (item->text(1).isEmpty()) {
+	current_entry = entry;
+
+	QModelIndex index = model->get_index(entry);
+	if (!index.isValid()) {
+		view->selectionModel()->clearSelection();
 		return;
 	}
+	view->selectionModel()->setCurrentIndex(index,
+			QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+	view->scrollTo(index); // unfolds the parents
+}
 
-	Poppler::LinkDestination *link = item->data(0, Qt::UserRole).value<Poppler::LinkDestination *>();
+void Toc::showEvent(QShowEvent *e) {
+	QWidget::showEvent(e);
+	update_current_entry();
+}
+
+void Toc::goto_link(const QModelIndex &index) {
+	// handle empty-indicator and entries without destination
+	Poppler::LinkDestination *link = model->get_destination(model->get_entry(index));
+	if (link == NULL) {
+		return;
+	}
 	viewer->get_canvas()->get_layout()->goto_link_destination(*link);
+	delete link;
 	viewer->get_canvas()->setFocus(Qt::OtherFocusReason);
 }
 
-bool Toc::event(QEvent *e) {
-	if (e->type() == QEvent::ShortcutOverride) {
+bool Toc::eventFilter(QObject *object, QEvent *e) {
+	if (object == view && e->type() == QEvent::ShortcutOverride) {
 		QKeyEvent *ke = static_cast<QKeyEvent *>(e);
 		if (ke->key() < Qt::Key_Escape) {
 			// don't accept -> other keyboard shortcuts take precedence
@@ -107,46 +608,6 @@ bool Toc::event(QEvent *e) {
 			}
 		}
 	}
-	return QTreeWidget::event(e);
-}
-
-void Toc::build(QDomNode *node, QTreeWidgetItem *parent) {
-	if (node->isNull() || !node->hasChildNodes()) {
-		return;
-	}
-
-	QDomNodeList list = node->childNodes();
-	for (int i = 0; i < list.count(); i++) {
-		QDomNode n = list.at(i);
-
-		QStringList strings;
-		strings << n.nodeName();
-		QDomNamedNodeMap attributes = n.attributes();
-		QDomNode dest = attributes.namedItem(QString::fromUtf8("Destination"));
-		Poppler::LinkDestination *link = NULL;
-		if (!dest.isNull()) {
-//			strings << dest.nodeValue();
-			link = new Poppler::LinkDestination(dest.nodeValue());
-		} else {
-			dest = attributes.namedItem(QString::fromUtf8("DestinationName"));
-			if (!dest.isNull()) {
-				link = viewer->get_res()->resolve_link_destination(dest.nodeValue());
-//				if (dest_page >= 0) {
-//					strings << QString::number(dest_page);
-//				}
-			}
-		}
-		if (!dest.isNull() && link != NULL) {
-			strings << QString::number(link->pageNumber());
-		}
-		// TODO check "ExternalFileName"
-		// TODO take "Open" into account?
-
-		QTreeWidgetItem *item = new QTreeWidgetItem(parent, strings);
-		item->setTextAlignment(1, Qt::AlignRight);
-		item->setData(0, Qt::UserRole, QVariant::fromValue(link));
-
-		build(&n, item);
-	}
+	return QWidget::eventFilter(object, e);
 }
 
@@ -1,34 +1,174 @@
 #ifndef TOC_H
 #define TOC_H
 
-#include <QTreeWidget>
+#include <QWidget>
+#include <QThread>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QAbstractItemModel>
 
 
-class QDomDocument;
 class QDomNode;
+class QLineEdit;
+class QTreeView;
+class QVBoxLayout;
 class Viewer;
+namespace Poppler {
+	class Document;
+	class LinkDestination;
+}
 
 
-class Toc : public QTreeWidget {
+// flat outline in document order, entry 0 is the invisible root
+// children of entry i are children[first_child, first_child + child_count)
+class TocTree {
+public:
+	struct Entry {
+		QString title;
+		QString destination; // explicit description or name, empty if there is none
+		bool named;
+		int parent;
+		int row; // index among the siblings
+		int first_child;
+		int child_count;
+		int page; // starting at 1, -1 if invalid
+	};
+
+	TocTree();
+
+	// sorts the entries with a valid page by page, then document order
+	void build_page_index();
+	// the last entry starting at or before page, the innermost section; -1 if there is none
+	int find_entry(int page) const;
+
+	QVector<Entry> entries;
+	QVector<int> children;
+	// page_entries[i] starts at index_pages[i], ascending
+	QVector<int> index_pages;
+	QVector<int> page_entries;
+};
+
+
+// converts the outline off the gui thread, with its own document
+// the tree is published first, named destinations are resolved afterwards
+class TocLoader : public QThread {
+	Q_OBJECT
+
+public:
+	TocLoader(const QString &file, const QByteArray &password);
+	~TocLoader();
+	void run();
+
+	// the tree once tree_built() was emitted, pages of named destinations
+	// are still missing; NULL before and after taking it
+	TocTree *take_tree();
+	// all pages and the page index once the thread has finished
+	TocTree *take_resolved_tree();
+
+	// checked between entries, a running poppler call is still waited for
+	volatile bool abort;
+
+signals:
+	void tree_built();
+
+private:
+	void build(const QDomNode &node, int parent);
+	int resolve_page(const TocTree::Entry &e) const;
+
+	QString file;
+	QByteArray password;
+	Poppler::Document *doc;
+	TocTree *tree;
+	TocTree *built; // copy handed out after the first pass
+};
+
+
+// two columns, title and page; only expanded parts of the tree are ever
+// queried by the view
+// a filter turns the tree into a flat list of the matching entries
+class TocModel : public QAbstractItemModel {
+	Q_OBJECT
+
+public:
+	TocModel(Viewer *v, QObject *parent = 0);
+	~TocModel();
+
+	// takes ownership, NULL clears the model
+	void set_tree(TocTree *new_tree);
+	// copies pages and page index of the same outline
+	void set_pages(const TocTree &resolved);
+	// shown instead of an empty list, e.g. while loading
+	void set_placeholder(const QString &text);
+	void set_filter(const QString &text);
+
+	// -1 for the placeholder
+	int get_entry(const QModelIndex &index) const;
+	// invalid if the entry is filtered out
+	QModelIndex get_index(int entry) const;
+	// see TocTree::find_entry()
+	int find_entry(int page) const;
+	// resolves on demand, NULL if the entry has no valid destination; free it
+	Poppler::LinkDestination *get_destination(int entry) const;
+
+	QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+	QModelIndex parent(const QModelIndex &index) const;
+	int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const;
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+	Qt::ItemFlags flags(const QModelIndex &index) const;
+
+private:
+	void update_matches();
+	bool is_filtered() const;
+	// without the placeholder
+	int get_top_level_count() const;
+
+	Viewer *viewer;
+	TocTree *tree;
+	QString placeholder;
+	QString filter;
+	QVector<int> matches; // entries matching the filter, in document order
+};
+
+
+class Toc : public QWidget {
 	Q_OBJECT
 
 public:
 	Toc(Viewer *v, QWidget *parent = 0);
 	~Toc();
 
-	void init();
+	void load(const QString &file, const QByteArray &password);
+	// highlights the section containing page
+	void set_current_page(int page);
 
 public slots:
-	void goto_link(QTreeWidgetItem *item, int column);
+	void goto_link(const QModelIndex &index);
 
 protected:
-	bool event(QEvent *e);
+	bool eventFilter(QObject *object, QEvent *e);
+	void showEvent(QShowEvent *e);
+
+private slots:
+	void tree_loaded();
+	void pages_loaded();
+	void set_filter(const QString &text);
 
 private:
 	void shutdown();
-	void build(QDomNode *node, QTreeWidgetItem *parent);
+	void update_current_entry();
 
 	Viewer *viewer;
+	int current_page;
+	int current_entry;
+
+	QVBoxLayout *layout;
+	QLineEdit *filter;
+	QTreeView *view;
+	TocModel *model;
+	TocLoader *loader;
 };
 
 #endif
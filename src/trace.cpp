@@ -0,0 +1,150 @@
+#include <QFile>
+#include <QCoreApplication>
+#include <iostream>
+#include "trace.h"
+#include "stats.h"
+
+using namespace std;
+
+
+// stop recording instead of eating up all memory
+static const size_t max_events = 4000000;
+
+
+Trace::Trace() :
+		enabled(false) {
+}
+
+Trace *Trace::get_instance() {
+	static Trace instance;
+	return &instance;
+}
+
+void Trace::start(const QString &file) {
+	this->file = file;
+	RenderStats::now(); // start the clock
+	set_thread_name("gui");
+	enabled = true;
+}
+
+bool Trace::is_enabled() const {
+	return enabled;
+}
+
+void Trace::add_span(const char *name, const char *category, qint64 start, qint64 end, int page) {
+	mutex.lock();
+	if (events.size() < max_events) {
+		Event e;
+		e.name = name;
+		e.category = category;
+		e.start = start;
+		e.duration = end - start;
+		e.tid = get_thread_id();
+		e.page = page;
+		events.push_back(e);
+	}
+	mutex.unlock();
+}
+
+void Trace::set_thread_name(const char *name) {
+	mutex.lock();
+	thread_names[get_thread_id()] = QString::fromUtf8(name);
+	mutex.unlock();
+}
+
+int Trace::get_thread_id() {
+	// called with mutex locked
+	Qt::HANDLE handle = QThread::currentThreadId();
+	QHash<Qt::HANDLE, int>::const_iterator it = thread_ids.find(handle);
+	if (it != thread_ids.end()) {
+		return it.value();
+	}
+	int id = thread_ids.size() + 1;
+	thread_ids.insert(handle, id);
+	return id;
+}
+
+bool Trace::write() {
+	if (!enabled) {
+		return true;
+	}
+	enabled = false;
+
+	QFile f(file);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		cerr << "failed to open " << file.toUtf8().constData() << endl;
+		return false;
+	}
+
+	mutex.lock();
+	qint64 pid = QCoreApplication::applicationPid();
+	QByteArray out = "{\"traceEvents\": [\n";
+	for (QHash<int, QString>::const_iterator it = thread_names.begin(); it != thread_names.end(); ++it) {
+		out += "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " + QByteArray::number(pid) +
+			", \"tid\": " + QByteArray::number(it.key()) +
+			", \"args\": {\"name\": \"" + it.value().toUtf8() + "\"}},\n";
+	}
+	for (size_t i = 0; i < events.size(); i++) {
+		const Event &e = events[i];
+		// timestamps are in microseconds
+		out += "{\"name\": \"" + QByteArray(e.name) + "\", \"cat\": \"" + QByteArray(e.category) +
+			"\", \"ph\": \"X\", \"ts\": " + QByteArray::number(e.start / 1000.0, 'f', 3) +
+			", \"dur\": " + QByteArray::number(e.duration / 1000.0, 'f', 3) +
+			", \"pid\": " + QByteArray::number(pid) +
+			", \"tid\": " + QByteArray::number(e.tid);
+		if (e.page != -1) {
+			out += ", \"args\": {\"page\": " + QByteArray::number(e.page) + "}";
+		}
+		out += "},\n";
+		if (out.size() > (1 << 20)) {
+			f.write(out);
+			out.clear();
+		}
+	}
+	// the format allows a trailing comma, but not everything reads it
+	if (out.endsWith(",\n")) {
+		out.chop(2);
+	}
+	out += "\n],\n\"displayTimeUnit\": \"ms\"}\n";
+	f.write(out);
+	bool ok = events.size() < max_events;
+	if (!ok) {
+		cerr << "trace was truncated after " << max_events << " events" << endl;
+	}
+	events.clear();
+	mutex.unlock();
+	return ok;
+}
+
+
+TraceSpan::TraceSpan(const char *name, const char *category, int page) :
+		name(name),
+		category(category),
+		page(page),
+		start(-1) {
+	if (Trace::get_instance()->is_enabled()) {
+		start = RenderStats::now();
+	}
+}
+
+TraceSpan::~TraceSpan() {
+	if (start != -1) {
+		Trace::get_instance()->add_span(name, category, start, RenderStats::now(), page);
+	}
+}
+
+
+void trace_lock(QMutex *mutex, const char *name) {
+	Trace *trace = Trace::get_instance();
+	if (!trace->is_enabled()) {
+		mutex->lock();
+		return;
+	}
+	if (mutex->tryLock()) {
+		return;
+	}
+	qint64 start = RenderStats::now();
+	mutex->lock();
+	trace->add_span(name, "lock", start, RenderStats::now());
+}
+
@@ -0,0 +1,71 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QMutex>
+#include <QString>
+#include <QHash>
+#include <QThread>
+#include <vector>
+
+
+// records spans in the Chrome trace event format, see chrome://tracing
+class Trace {
+public:
+	static Trace *get_instance();
+
+	// enables tracing, the events are written to file by write()
+	void start(const QString &file);
+	bool is_enabled() const;
+	bool write();
+
+	// name and category must be string literals, page is -1 if not applicable
+	void add_span(const char *name, const char *category, qint64 start, qint64 end, int page = -1);
+	// shown instead of the numeric thread id
+	void set_thread_name(const char *name);
+
+private:
+	Trace();
+
+	struct Event {
+		const char *name;
+		const char *category;
+		qint64 start; // nanoseconds, RenderStats::now()
+		qint64 duration;
+		int tid;
+		int page;
+	};
+
+	// small numbers instead of pointer-sized thread handles
+	int get_thread_id();
+
+	volatile bool enabled;
+	QString file;
+	std::vector<Event> events;
+	QHash<Qt::HANDLE, int> thread_ids;
+	QHash<int, QString> thread_names;
+	QMutex mutex;
+};
+
+
+// records the lifetime of the object as a span
+class TraceSpan {
+public:
+	TraceSpan(const char *name, const char *category, int page = -1);
+	~TraceSpan();
+
+private:
+	const char *name;
+	const char *category;
+	int page;
+	qint64 start;
+};
+
+#define TRACE_CONCAT2(a, b) a ## b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SPAN(...) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)
+
+// locks mutex and records the time spent waiting for it
+void trace_lock(QMutex *mutex, const char *name);
+
+#endif
+
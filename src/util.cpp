@@ -1,6 +1,12 @@
 #include <QAction>
 #include <QObject>
 #include <QImage>
+#include <QDir>
+#if QT_VERSION >= 0x050000
+#	include <QStandardPaths>
+#else
+#	include <QDesktopServices>
+#endif
 //#include <QTime>
 //#include <iostream>
 #include "util.h"
@@ -84,3 +90,19 @@ void invert_image(QImage *img) {
 //	cout << time.elapsed() << "ms elapsed" << endl;
 }
 
+QString get_cache_dir(const QString &subdir) {
+#if QT_VERSION >= 0x050000
+	QString base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+#else
+	QString base = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+	if (base.isEmpty()) {
+		return QString();
+	}
+	QDir dir(base + QString::fromUtf8("/katarakt/") + subdir);
+	if (!dir.exists() && !dir.mkpath(QString::fromUtf8("."))) {
+		return QString();
+	}
+	return dir.path();
+}
+
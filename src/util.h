@@ -6,6 +6,7 @@
 
 
 class QImage;
+class QString;
 
 
 #define POPPLER_VERSION ((POPPLER_VERSION_MAJOR << 16) | (POPPLER_VERSION_MINOR << 8) | (POPPLER_VERSION_MICRO))
@@ -27,5 +28,8 @@ void add_action(QWidget *base, const char *action, const char *slot, QWidget *re
 
 void invert_image(QImage *img);
 
+// per-user cache directory, created if necessary; empty on failure
+QString get_cache_dir(const QString &subdir);
+
 #endif
 
@@ -15,6 +15,7 @@
 #include "beamerwindow.h"
 #include "toc.h"
 #include "splitter.h"
+#include "scrollanimation.h"
 #include "util.h"
 
 using namespace std;
@@ -192,7 +193,7 @@ void Viewer::reload(bool clamp) {
 
 	update_info_widget();
 
-	toc->init();
+	toc->load(res->get_file(), info_password.text().toLatin1());
 	canvas->get_layout()->clear_selection();
 	canvas->reload(clamp);
 
@@ -208,6 +209,7 @@ void Viewer::open(QString new_file) {
 	// e.g. in inotify-caused reload it doesn't hurt to keep the old jumplist
 	// search is always cleared, see reload()
 	res->clear_jumps();
+	download_error.clear();
 	// TODO reset rotation?
 	setWindowTitle(QString::fromUtf8("%1 \u2014 katarakt").arg(info.fileName()));
 	reload();
@@ -323,7 +325,7 @@ void Viewer::screen_down() {
 
 void Viewer::smooth_up() {
 	if (canvas->get_layout()->supports_smooth_scrolling()) {
-		canvas->get_layout()->scroll_smooth(0, smooth_scroll_delta);
+		canvas->get_scroll_animation()->scroll_smooth(0, smooth_scroll_delta);
 	} else { // fallback
 		page_up();
 	}
@@ -331,7 +333,7 @@ void Viewer::smooth_up() {
 
 void Viewer::smooth_down() {
 	if (canvas->get_layout()->supports_smooth_scrolling()) {
-		canvas->get_layout()->scroll_smooth(0, -smooth_scroll_delta);
+		canvas->get_scroll_animation()->scroll_smooth(0, -smooth_scroll_delta);
 	} else { // fallback
 		page_down();
 	}
@@ -339,7 +341,7 @@ void Viewer::smooth_down() {
 
 void Viewer::smooth_left() {
 	if (canvas->get_layout()->supports_smooth_scrolling()) {
-		canvas->get_layout()->scroll_smooth(smooth_scroll_delta, 0);
+		canvas->get_scroll_animation()->scroll_smooth(smooth_scroll_delta, 0);
 	} else { // fallback
 		page_up();
 	}
@@ -347,21 +349,24 @@ void Viewer::smooth_left() {
 
 void Viewer::smooth_right() {
 	if (canvas->get_layout()->supports_smooth_scrolling()) {
-		canvas->get_layout()->scroll_smooth(-smooth_scroll_delta, 0);
+		canvas->get_scroll_animation()->scroll_smooth(-smooth_scroll_delta, 0);
 	} else { // fallback
 		page_down();
 	}
 }
 
 void Viewer::zoom_in() {
+	canvas->notify_motion();
 	canvas->get_layout()->set_zoom(1);
 }
 
 void Viewer::zoom_out() {
+	canvas->notify_motion();
 	canvas->get_layout()->set_zoom(-1);
 }
 
 void Viewer::reset_zoom() {
+	canvas->notify_motion();
 	canvas->get_layout()->set_zoom(0, false);
 }
 
@@ -421,12 +426,14 @@ void Viewer::rotate_left() {
 	res->rotate(-1);
 	canvas->get_layout()->rebuild();
 	canvas->update();
+	beamer->update();
 }
 
 void Viewer::rotate_right() {
 	res->rotate(1);
 	canvas->get_layout()->rebuild();
 	canvas->update();
+	beamer->update();
 }
 
 void Viewer::invert_colors() {
@@ -484,11 +491,26 @@ void Viewer::update_info_widget() {
 		}
 		info_label_icon.setPixmap(icon.pixmap(32, 32));
 		info_widget.show();
+	} else if (!download_error.isEmpty()) {
+		QIcon icon = QIcon::fromTheme(QString::fromUtf8("dialog-warning"));
+
+		info_label_text.setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
+		info_label_text.setText(
+			QString::fromUtf8("Download incomplete: ") + download_error);
+
+		info_password.hide();
+		info_label_icon.setPixmap(icon.pixmap(32, 32));
+		info_widget.show();
 	} else {
 		info_widget.hide();
 	}
 }
 
+void Viewer::show_download_error(const QString &error) {
+	download_error = error;
+	update_info_widget();
+}
+
 ResourceManager *Viewer::get_res() const {
 	return res;
 }
@@ -511,12 +533,15 @@ void Viewer::layout_updated(int new_page, bool page_changed) {
 		if (beamer->isVisible() && !beamer->is_frozen()) {
 			beamer->get_layout()->scroll_page(new_page, false);
 		}
-		// TODO unfold toc tree to show current entry?
+		toc->set_current_page(new_page);
 		canvas->update_page_overlay();
 		presenter_progress.setValue(new_page + 1);
 	}
 	canvas->update();
-	beamer->update();
+	// a frozen beamer keeps its slide, it is updated when unfreezing
+	if (beamer->isVisible() && !beamer->is_frozen()) {
+		beamer->update();
+	}
 }
 
 void Viewer::show_progress(bool show) {
@@ -40,6 +40,8 @@ public slots:
 
 	void reload(bool clamp = true);
 	void open(QString filename);
+	// the shown file is an incomplete download
+	void show_download_error(const QString &error);
 
 private slots:
 	// movement
@@ -107,6 +109,7 @@ private:
 	QLabel info_label_icon;
 	QLabel info_label_text;
 	QLineEdit info_password;
+	QString download_error; // empty if there is none
 
 	// signal handling
 	static void signal_handler(int unused);
@@ -2,9 +2,13 @@
 #include "resourcemanager.h"
 #include "kpage.h"
 #include "canvas.h"
-#include "selection.h"
+#include "textlayer.h"
+#include "linklayer.h"
 #include "util.h"
 #include "config.h"
+#include "stats.h"
+#include "trace.h"
+#include "thumbnailcache.h"
 #include <list>
 #include <iostream>
 #if QT_VERSION >= 0x050000
@@ -18,22 +22,42 @@ using namespace std;
 
 Worker::Worker(ResourceManager *res) :
 		die(false),
-		res(res) {
+		res(res),
+		stats(RenderStats::get_instance()),
+		fast_hints(false) {
 	// load config options
 	CFG *config = CFG::get_instance();
 	smooth_downscaling = config->get_value("Settings/thumbnail_filter").toBool();
-	thumbnail_size = config->get_value("Settings/thumbnail_size").toInt();
+	motion_dpi_factor = config->get_value("Settings/motion_dpi_factor").toFloat();
 }
 
 void Worker::run() {
+	Trace::get_instance()->set_thread_name("render worker");
 	while (1) {
-		res->requestSemaphore.acquire(1);
+		// render thumbnails while there is nothing else to do
+		if (!res->requestSemaphore.tryAcquire(1)) {
+			if (!die && render_thumbnail()) {
+				continue;
+			}
+			res->requestSemaphore.acquire(1);
+		}
 		if (die) {
 			break;
 		}
 
+		// provide scaled drafts for all pages that are waiting to be rendered
+		prescale_requests();
+
 		// get next page to render
-		res->requestMutex.lock();
+		trace_lock(&res->requestMutex, "requestMutex");
+		if (!res->text_requests.empty()) {
+			// cheap and needed for interaction, e.g. selecting text
+			int page = *res->text_requests.begin();
+			res->text_requests.erase(res->text_requests.begin());
+			res->requestMutex.unlock();
+			extract_text(page, NULL);
+			continue;
+		}
 		int page, width, index;
 		map<int,Request>::iterator less = res->requests.lower_bound(res->center_page);
 		map<int,Request>::iterator greater = less--;
@@ -57,19 +81,29 @@ void Worker::run() {
 		page = closest->first;
 		index = closest->second.get_lowest_index();
 		width = closest->second.width[index];
+		qint64 queued = closest->second.queued[index];
 		if (closest->second.remove_index_ok(index)) {
 			res->requestSemaphore.release(1);
 		} else {
 			res->requests.erase(closest);
 		}
+		stats->set_queue_depth(res->requests.size());
 		res->requestMutex.unlock();
 
+		qint64 start = RenderStats::now();
+		stats->add_timing(RenderStats::QueueWait, start - queued);
+		TRACE_SPAN("render", "worker", page);
+
 		// check for duplicate requests
 		KPage &kp = res->k_page[page];
 
-		kp.mutex.lock();
+		// render a cheap draft while the view is moving
+		bool draft = res->motion.fetchAndAddRelaxed(0) != 0 && motion_dpi_factor < 1.0f;
+
+		trace_lock(&kp.mutex, "KPage::mutex");
 		bool render_new = true;
-		if (kp.status[index] == width && kp.rotation[index] == res->rotation) {
+		if (kp.status[index] == width && kp.rotation[index] == res->rotation &&
+				(!kp.draft[index] || draft)) {
 			if (kp.img[index].isNull()) { // only invert colors
 				render_new = false;
 			} else { // nothing to do
@@ -94,16 +128,31 @@ void Worker::run() {
 
 			// render page
 			float dpi = 72.0 * width / res->get_page_width(page);
+			if (draft) {
+				dpi *= motion_dpi_factor;
+			}
+			if (draft != fast_hints) {
+				ResourceManager::set_render_hints(res->doc, draft);
+				fast_hints = draft;
+			}
 			QImage img = p->renderToImage(dpi, dpi, -1, -1, -1, -1,
 					static_cast<Poppler::Page::Rotation>(rotation));
+			qint64 rendered = RenderStats::now();
+			stats->add_timing(RenderStats::Render, rendered - start);
+			start = rendered;
 
 			if (img.isNull()) {
 				cerr << "failed to render page " << page << endl;
 				continue;
 			}
+			if (draft) {
+				// blow up to the requested size, layouts can draw it as-is
+				int height = ROUND((float) img.height() * width / img.width());
+				img = img.scaled(width, height, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+			}
 
 			// insert new image
-			kp.mutex.lock();
+			trace_lock(&kp.mutex, "KPage::mutex");
 			if (kp.inverted_colors) {
 				kp.img[index] = QImage();
 				kp.img_other[index] = img;
@@ -113,41 +162,19 @@ void Worker::run() {
 			}
 			kp.status[index] = width;
 			kp.rotation[index] = rotation;
+			kp.draft[index] = draft;
 		} else {
 			// image already exists
-			kp.mutex.lock();
+			trace_lock(&kp.mutex, "KPage::mutex");
 		}
 
 		if (kp.inverted_colors) {
 			// generate inverted image
 			kp.img[index] = kp.img_other[index];
 			invert_image(&kp.img[index]);
+			start = time_stage(RenderStats::Invert, start);
 		}
 
-		// create thumbnail
-		if (kp.thumbnail.isNull()) {
-			Qt::TransformationMode mode = Qt::FastTransformation;
-			if (smooth_downscaling) {
-				mode = Qt::SmoothTransformation;
-			}
-			// scale
-			if (kp.inverted_colors) {
-				kp.thumbnail = kp.img_other[index].scaled(QSize(thumbnail_size, thumbnail_size), Qt::IgnoreAspectRatio, mode);
-			} else {
-				kp.thumbnail = kp.img[index].scaled(QSize(thumbnail_size, thumbnail_size), Qt::IgnoreAspectRatio, mode);
-			}
-			// rotate
-			if (kp.rotation[index] != 0) {
-				QTransform trans;
-				trans.rotate(-kp.rotation[index] * 90);
-				kp.thumbnail = kp.thumbnail.transformed(trans);
-			}
-			kp.thumbnail_other = kp.thumbnail;
-			invert_image(&kp.thumbnail_other);
-			if (kp.inverted_colors) {
-				kp.thumbnail.swap(kp.thumbnail_other);
-			}
-		}
 		kp.mutex.unlock();
 
 		res->garbageMutex.lock();
@@ -155,86 +182,226 @@ void Worker::run() {
 		res->garbageMutex.unlock();
 
 		emit page_rendered(page);
+		start = time_stage(RenderStats::Publish, start);
 
-		// collect goto links
-		res->link_mutex.lock();
-		if (kp.links == NULL) {
-			res->link_mutex.unlock();
-
-			QList<Poppler::Link *> *links = new QList<Poppler::Link *>;
-			QList<Poppler::Link *> l = p->links();
-			links->swap(l);
-
-			res->link_mutex.lock();
-			kp.links = links;
-		}
-		if (kp.text == NULL) {
-			res->link_mutex.unlock();
-
-			QList<Poppler::TextBox *> text = p->textList();
-			// assign boxes to lines
-			// make single parts from chained boxes
-			set<Poppler::TextBox *> used;
-			QList<SelectionPart *> selection_parts;
-			Q_FOREACH(Poppler::TextBox *box, text) {
-				if (used.find(box) != used.end()) {
-					continue;
-				}
-				used.insert(box);
-
-				SelectionPart *p = new SelectionPart(box);
-				selection_parts.push_back(p);
-				Poppler::TextBox *next = box->nextWord();
-				while (next != NULL) {
-					used.insert(next);
-					p->add_word(next);
-					next = next->nextWord();
-				}
-			}
+		// text and links might have been freed while the image was kept
+		extract_text(page, p);
 
-			// sort by y coordinate
-			stable_sort(selection_parts.begin(), selection_parts.end(), selection_less_y);
-
-			QRectF line_box;
-			QList<SelectionLine *> *lines = new QList<SelectionLine *>();
-			Q_FOREACH(SelectionPart *part, selection_parts) {
-				QRectF box = part->get_bbox();
-				// box fits into line_box's line
-				if (!lines->empty() && box.y() <= line_box.center().y() && box.bottom() > line_box.center().y()) {
-					float ratio_w = box.width() / line_box.width();
-					float ratio_h = box.height() / line_box.height();
-					if (ratio_w < 1.0f) {
-						ratio_w = 1.0f / ratio_w;
-					}
-					if (ratio_h < 1.0f) {
-						ratio_h = 1.0f / ratio_h;
-					}
-					if (ratio_w > 1.3f && ratio_h > 1.3f) {
-						lines->back()->sort();
-						lines->push_back(new SelectionLine(part));
-						line_box = part->get_bbox();
-					} else {
-						lines->back()->add_part(part);
-					}
-				// it doesn't fit, create new line
-				} else {
-					if (!lines->empty()) {
-						lines->back()->sort();
-					}
-					lines->push_back(new SelectionLine(part));
-					line_box = part->get_bbox();
-				}
-			}
-			if (!lines->empty()) {
-				lines->back()->sort();
-			}
+		delete p;
+	}
+}
+
+
+void Worker::extract_text(int page, Poppler::Page *p) {
+	KPage &kp = res->k_page[page];
+	res->link_mutex.lock();
+	bool need_links = kp.links == NULL;
+	bool need_text = kp.text == NULL;
+	res->link_mutex.unlock();
+	if (!need_links && !need_text) {
+		return;
+	}
 
-			res->link_mutex.lock();
-			kp.text = lines;
+	TRACE_SPAN("extract text", "worker", page);
+	qint64 start = RenderStats::now();
+	Poppler::Page *own = NULL;
+	if (p == NULL) {
+		own = p = res->doc->page(page);
+		if (p == NULL) {
+			cerr << "failed to load page " << page << endl;
+			return;
 		}
-		res->link_mutex.unlock();
+	}
+	// index links by their area
+	LinkLayer *links = NULL;
+	if (need_links) {
+		links = new LinkLayer(p->links());
+	}
+	// assign boxes to lines in reading order
+	TextLayer *layer = NULL;
+	if (need_text) {
+		layer = new TextLayer(p->textList());
+	}
+	delete own;
+
+	// only the gui thread frees text, so both are still NULL
+	res->link_mutex.lock();
+	res->text_bytes -= res->get_text_size(page);
+	if (links != NULL) {
+		kp.links = links;
+	}
+	if (layer != NULL) {
+		kp.text = layer;
+	}
+	res->text_bytes += res->get_text_size(page);
+	res->text_pages.insert(page);
+	res->link_mutex.unlock();
+	time_stage(RenderStats::TextExtraction, start);
 
+	emit text_extracted(page);
+}
+
+void Worker::prescale_requests() {
+	// only requests that found another image of their page, see get_page()
+	// pages must not be locked while holding requestMutex
+	map<pair<int, int>, int> pending;
+	res->requestMutex.lock();
+	pending.swap(res->stale_requests);
+	// skip requests that were rendered or dropped in the meantime
+	for (map<pair<int, int>, int>::iterator it = pending.begin(); it != pending.end(); ) {
+		map<int,Request>::const_iterator r = res->requests.find(it->first.first);
+		if (r == res->requests.end() || r->second.width[it->first.second] != it->second) {
+			pending.erase(it++);
+		} else {
+			++it;
+		}
+	}
+	res->requestMutex.unlock();
+
+	for (map<pair<int, int>, int>::const_iterator it = pending.begin(); it != pending.end(); ++it) {
+		prescale(it->first.first, it->second, it->first.second);
+	}
+}
+
+bool Worker::render_thumbnail() {
+	ThumbnailCache *cache = res->thumbnails;
+	if (cache == NULL) {
+		return false;
+	}
+	res->requestMutex.lock();
+	int center = res->center_page;
+	res->requestMutex.unlock();
+
+	int page = cache->next_missing(center);
+	if (page == -1) {
+		cache->save(); // only writes once
+		return false;
+	}
+
+	TRACE_SPAN("thumbnail", "worker", page);
+	qint64 start = RenderStats::now();
+	QSize size = cache->get_size(page);
+	QImage img;
+	Poppler::Page *p = res->doc->page(page);
+	if (p != NULL) {
+		if (fast_hints) {
+			ResourceManager::set_render_hints(res->doc);
+			fast_hints = false;
+		}
+		// render directly at the thumbnail size, much cheaper than a full render
+		float dpi = 72.0 * size.width() / res->get_page_width(page, false);
+		img = p->renderToImage(dpi, dpi);
 		delete p;
 	}
+	if (img.isNull()) {
+		cerr << "failed to render thumbnail for page " << page << endl;
+		// don't try again
+		img = QImage(size, QImage::Format_RGB32);
+		img.fill(0xffffffff);
+	} else if (img.size() != size) {
+		// rounding, off by a pixel at most
+		Qt::TransformationMode mode = Qt::FastTransformation;
+		if (smooth_downscaling) {
+			mode = Qt::SmoothTransformation;
+		}
+		img = img.scaled(size, Qt::IgnoreAspectRatio, mode);
+	}
+	set_thumbnail(page, img);
+	time_stage(RenderStats::Thumbnail, start);
+
+	emit page_rendered(page);
+	return true;
+}
+
+void Worker::set_thumbnail(int page, const QImage &img) {
+	res->thumbnails->insert(page, img);
+	// copy outside of the page lock
+	QImage normal = res->thumbnails->get(page, false);
+	QImage inverted = res->thumbnails->get(page, true);
+
+	KPage &kp = res->k_page[page];
+	trace_lock(&kp.mutex, "KPage::mutex");
+	kp.thumbnail = kp.inverted_colors ? inverted : normal;
+	kp.thumbnail_other = kp.inverted_colors ? normal : inverted;
+	kp.mutex.unlock();
 }
 
+qint64 Worker::time_stage(enum RenderStats::Stage stage, qint64 start) {
+	qint64 end = RenderStats::now();
+	stats->add_timing(stage, end - start);
+	return end;
+}
+
+bool Worker::prescale(int page, int width, int index) {
+	TRACE_SPAN("prescale", "worker", page);
+	KPage &kp = res->k_page[page];
+
+	kp.mutex.lock();
+	int rotation = res->rotation;
+	// there already is an image (or draft) of the right size
+	if (!kp.img[index].isNull() && kp.status[index] == width && kp.rotation[index] == rotation) {
+		kp.mutex.unlock();
+		return false;
+	}
+	// take the biggest properly rendered image as source, regardless of rotation
+	int source = -1;
+	for (int i = 0; i < 3; i++) {
+		if (kp.img[i].isNull() || kp.draft[i]) {
+			continue;
+		}
+		if (source == -1 || kp.img[i].width() * kp.img[i].height() >
+				kp.img[source].width() * kp.img[source].height()) {
+			source = i;
+		}
+	}
+	if (source == -1) {
+		kp.mutex.unlock();
+		return false;
+	}
+	// QImage is implicitly shared, copies are cheap
+	QImage img = kp.img[source];
+	QImage img_other = kp.img_other[source];
+	int rot = (rotation - kp.rotation[source] + 4) % 4;
+	bool inverted_colors = kp.inverted_colors;
+	kp.mutex.unlock();
+
+	// transform without holding the lock, painting must not be blocked
+	// rotate first, the requested width is given for the current rotation
+	if (rot != 0) {
+		QTransform trans;
+		trans.rotate(rot * 90);
+		img = img.transformed(trans);
+		if (!img_other.isNull()) {
+			img_other = img_other.transformed(trans);
+		}
+	}
+	if (img.width() != width) {
+		int height = ROUND((float) img.height() * width / img.width());
+		img = img.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+		if (!img_other.isNull()) {
+			img_other = img_other.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+		}
+	}
+
+	kp.mutex.lock();
+	if (res->rotation != rotation) { // outdated
+		kp.mutex.unlock();
+		return false;
+	}
+	if (kp.inverted_colors != inverted_colors) { // colors were toggled in the meantime
+		img.swap(img_other);
+	}
+	kp.img[index] = img;
+	kp.img_other[index] = img_other;
+	kp.status[index] = width;
+	kp.rotation[index] = rotation;
+	kp.draft[index] = true;
+	kp.mutex.unlock();
+
+	res->garbageMutex.lock();
+	res->garbage[index].insert(page);
+	res->garbageMutex.unlock();
+
+	emit page_rendered(page);
+	return true;
+}
@@ -2,10 +2,15 @@
 #define WORKER_H
 
 #include <QThread>
+#include <QImage>
+#include "stats.h"
 
 
 class ResourceManager;
 class Canvas;
+namespace Poppler {
+	class Page;
+}
 
 
 class Worker : public QThread {
@@ -19,13 +24,27 @@ public:
 
 signals:
 	void page_rendered(int page);
+	void text_extracted(int page);
 
 private:
+	// extracts missing text and links, loads the page if p is NULL
+	void extract_text(int page, Poppler::Page *p);
+	// renders the next missing thumbnail, returns false if there is none
+	bool render_thumbnail();
+	void set_thumbnail(int page, const QImage &img);
+	// rotates and scales available images to fit pending requests
+	void prescale_requests();
+	bool prescale(int page, int width, int index);
+	// records the time since start, returns the current time
+	qint64 time_stage(enum RenderStats::Stage stage, qint64 start);
+
 	ResourceManager *res;
+	RenderStats *stats;
+	bool fast_hints;
 
 	// config options
 	bool smooth_downscaling;
-	int thumbnail_size;
+	float motion_dpi_factor;
 };
 
 #endif